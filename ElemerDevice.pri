@@ -4,12 +4,33 @@ include(../CommonInterfaces/CommonInterfaces.pri)
 
 HEADERS += \
     $$PWD/ed_common_types.h \
+    $$PWD/ed_core.h \
     $$PWD/ed_device.h \
+    $$PWD/ed_filemirror.h \
+    $$PWD/ed_filesession.h \
+    $$PWD/ed_history.h \
     $$PWD/ed_port.h \
+    $$PWD/ed_response.h \
+    $$PWD/ed_samples.h \
+    $$PWD/ed_scheduler.h \
     $$PWD/ed_utils.h
 
+unix {
+    HEADERS += \
+        $$PWD/ed_fdport.h \
+        $$PWD/ed_shm.h \
+        $$PWD/ed_store.h
+    SOURCES += \
+        $$PWD/ed_shm.cpp \
+        $$PWD/ed_store.cpp
+    linux: LIBS += -lrt
+}
+
 INCLUDEPATH += $$PWD
 
 SOURCES += \
     $$PWD/ed_device.cpp \
-    $$PWD/ed_port.cpp
+    $$PWD/ed_filemirror.cpp \
+    $$PWD/ed_filesession.cpp \
+    $$PWD/ed_port.cpp \
+    $$PWD/ed_scheduler.cpp
@@ -0,0 +1,17 @@
+QT += core serialport
+QT -= gui
+
+CONFIG += c++2a console
+CONFIG -= app_bundle
+
+TARGET = elemer-daemon
+TEMPLATE = app
+
+include(../ElemerDevice.pri)
+
+HEADERS += \
+    $$PWD/ed_daemon.h
+
+SOURCES += \
+    $$PWD/ed_daemon.cpp \
+    $$PWD/main.cpp
@@ -0,0 +1,284 @@
+#include "ed_daemon.h"
+#include "ed_device.h"
+#ifdef Q_OS_UNIX
+#include "ed_shm.h"
+#include "ed_store.h"
+#endif
+
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <chrono>
+#include <span>
+
+namespace Elemer {
+
+namespace {
+
+    /// добавление поля "str;" в строку вывода; возвращает число записанных символов
+    size_t putField(std::span<char> out, std::string_view str) {
+        if (out.size() < str.size() + 1)
+            return 0;
+        std::memcpy(out.data(), str.data(), str.size());
+        out[str.size()] = ';';
+        return str.size() + 1;
+    }
+
+    int64_t nowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+
+} // namespace
+
+Daemon::Daemon(QObject* parent)
+    : QObject(parent) {
+    connect(&flushTimer_, &QTimer::timeout, this, [this] {
+        QMutexLocker locker(&outputMutex_);
+        output_.flush();
+    });
+    connect(&statsTimer_, &QTimer::timeout, this, &Daemon::printStats);
+    connect(&reconnectTimer_, &QTimer::timeout, this, &Daemon::reconnect);
+}
+
+Daemon::~Daemon() {
+    stop();
+}
+
+bool Daemon::load(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        emit message(path + ": " + file.errorString());
+        return false;
+    }
+    QJsonParseError error;
+    const QJsonObject config = QJsonDocument::fromJson(file.readAll(), &error).object();
+    if (error.error != QJsonParseError::NoError) {
+        emit message(path + ": " + error.errorString() + " (" + QString::number(error.offset) + ")");
+        return false;
+    }
+
+    const QString output = config["output"].toString("-");
+    const bool opened = output == "-"
+        ? output_.open(stdout, QIODevice::WriteOnly)
+        : (output_.setFileName(output), output_.open(QIODevice::WriteOnly | QIODevice::Append));
+    if (!opened) {
+        emit message(output + ": " + output_.errorString());
+        return false;
+    }
+
+    const QJsonArray devices = config["devices"].toArray();
+    if (devices.isEmpty()) {
+        emit message(path + ": список приборов пуст");
+        return false;
+    }
+#ifdef Q_OS_UNIX
+    if (config.contains("shm")) {
+        publisher_ = std::make_unique<ShmPublisher>(config["shm"].toString().toStdString(), devices.size());
+        if (!publisher_->isValid())
+            emit message(config["shm"].toString() + ": разделяемая память недоступна");
+    }
+    if (config.contains("store")) {
+        store_ = std::make_unique<Store>(config["store"].toString().toStdString());
+        if (!store_->isValid()) {
+            emit message(config["store"].toString() + ": архив недоступен или занят другим процессом");
+            return false;
+        }
+    }
+#endif
+    for (const QJsonValue& device : devices) {
+        if (!addDevice(device.toObject()))
+            return false;
+    }
+    statsTimer_.setInterval(config["stats"].toInt(60) * 1000);
+    reconnectTimer_.setInterval(config["reconnect"].toInt(5) * 1000);
+    return true;
+}
+
+bool Daemon::addDevice(const QJsonObject& config) {
+    // без проверки прибор неизвестного типа (UnknownDevice) молча не подключался бы никогда
+    const int type = config["type"].toInt();
+    if (type <= 0 || type > 255 || deviceTraitsOf(static_cast<DeviceType>(type)).Tip == 0) {
+        emit message(config["name"].toString(config["port"].toString()) + ": неизвестный или не заданный тип прибора \"type\"");
+        return false;
+    }
+    auto& unit = *units_.emplace_back(std::make_unique<Unit>());
+    unit.port = config["port"].toString();
+    unit.baud = config["baud"].toInt(9600);
+    unit.address = static_cast<uint8_t>(config["address"].toInt());
+    unit.name = config["name"].toString(unit.port).toStdString();
+    unit.device = std::make_unique<DynamicDevice>(static_cast<DeviceType>(type));
+    unit.samples = unit.device->makeSamples();
+    Device* device = unit.device.get();
+    connect(device, &Device::message, this, [this, name = QString::fromStdString(unit.name)](const QString& msg) {
+        emit message(name + ": " + msg);
+    });
+    device->port()->setHalfDuplex(config["rs485"].toBool());
+#ifdef Q_OS_UNIX
+    if (publisher_ && publisher_->isValid())
+        device->setPublisher(publisher_.get(), static_cast<uint32_t>(units_.size() - 1));
+    if (store_)
+        device->setStore(store_.get(), (static_cast<uint32_t>(device->type()) << 8) | unit.address);
+#endif
+    // прибор не опрашивается при загрузке: первый ping выполняет reconnect() из start()
+    // в потоке порта, чтобы недоступные приборы не задерживали запуск остальных
+
+    for (const QJsonValue& value : config["poll"].toArray()) {
+        const QJsonObject poll = value.toObject();
+        const std::chrono::milliseconds period { poll["period"].toInt(1000) };
+        if (!poll.contains("command")) {
+            scheduler_.addPeriodic(device, period, [this, &unit] {
+                const uint64_t sequence = unit.samples.sequence;
+                const bool ok = unit.device->readData(unit.samples);
+                if (unit.samples.sequence != sequence) // ответ получен, хотя бы частично
+                    writeSamples(unit);
+                return ok;
+            });
+            continue;
+        }
+        const int command = poll["command"].toInt();
+        Core::FrameBuilder frame(unit.address, static_cast<uint8_t>(command));
+        for (const QJsonValue& arg : poll["args"].toArray()) {
+            if (arg.isString())
+                frame.append(std::string_view { arg.toString().toStdString() });
+            else if (const double d = arg.toDouble(); d == static_cast<long long>(d))
+                frame.append(static_cast<long long>(d));
+            else
+                frame.append(d);
+        }
+        if (!frame.finish().ok()) {
+            emit message(QString::fromStdString(unit.name) + ": слишком длинная посылка команды " + QString::number(command));
+            return false;
+        }
+        scheduler_.addPeriodic(device, period,
+            [this, &unit, command, request = QByteArray(frame.view().data(), static_cast<int>(frame.view().size()))] {
+                const QByteArray reply = unit.device->transactRaw(request);
+                if (!reply.isEmpty())
+                    writeReply(unit, command, reply);
+                return !reply.isEmpty();
+            });
+    }
+
+    return true;
+}
+
+void Daemon::reconnect() {
+    // приборы, ещё не найденные или потерявшие связь, ищутся заново в потоке их порта
+    for (const auto& unit : units_) {
+        if (unit->device->isConnected() || unit->reconnecting.exchange(true))
+            continue;
+        scheduler_.post(
+            unit->device.get(), [this, u = unit.get()] {
+                const bool ok = u->device->ping(u->port, u->baud, u->address);
+                if (ok)
+                    u->reported = false;
+                else if (!u->reported.exchange(true))
+                    emit message(QString::fromStdString(u->name) + ": прибор не отвечает");
+                u->reconnecting = false;
+                return ok;
+            },
+            Lane::Background);
+    }
+}
+
+void Daemon::writeSamples(Unit& unit) {
+    const std::span<char> out { unit.line };
+    size_t n = Core::formatField(out, unit.samples.timestamp / 1'000'000);
+    n += putField(out.subspan(n), unit.name);
+    for (size_t ch {}; ch < unit.samples.channels(); ++ch) {
+        n += unit.samples.status[ch] == SampleStatus::Ok
+            ? Core::formatField(out.subspan(n), unit.samples.values[ch])
+            : putField(out.subspan(n), {});
+    }
+    out[n - 1] = '\n';
+    write(out.data(), n);
+}
+
+void Daemon::writeReply(Unit& unit, int command, const QByteArray& reply) {
+    // "!адрес;поле1;...;полеN;CRC\r" -> "поле1;...;полеN;"
+    const std::string_view frame { reply.constData(), static_cast<size_t>(reply.size()) };
+    const size_t first = frame.find(';');
+    const size_t last = frame.rfind(';');
+    const std::string_view fields = first < last ? frame.substr(first + 1, last - first) : std::string_view {};
+
+    const std::span<char> out { unit.line };
+    size_t n = Core::formatField(out, nowMs());
+    n += putField(out.subspan(n), unit.name);
+    if (n + 1 < out.size()) {
+        out[n++] = '#';
+        n += Core::formatField(out.subspan(n), command);
+    }
+    n += putField(out.subspan(n), fields.substr(0, fields.empty() ? 0 : fields.size() - 1));
+    out[n - 1] = '\n';
+    write(out.data(), n);
+}
+
+void Daemon::write(const char* data, size_t size) {
+    QMutexLocker locker(&outputMutex_);
+    output_.write(data, static_cast<qint64>(size));
+    ++lines_;
+}
+
+void Daemon::start() {
+    scheduler_.start();
+    reconnect(); // первое подключение всех приборов параллельно, не дожидаясь таймера
+    flushTimer_.start(1000);
+    statsClock_.start();
+    if (statsTimer_.interval() > 0)
+        statsTimer_.start();
+    if (reconnectTimer_.interval() > 0)
+        reconnectTimer_.start();
+}
+
+void Daemon::stop() {
+    flushTimer_.stop();
+    statsTimer_.stop();
+    reconnectTimer_.stop();
+    // отмена транзакций всех приборов, затем остановка планировщика (задачи завершаются
+    // без ожидания ответов) и только после этого - потоков портов, к которым обращаются задачи
+    std::vector<Device*> devices;
+    for (const auto& unit : units_)
+        devices.push_back(unit->device.get());
+    Device::abortAll(devices);
+    scheduler_.stop();
+    Device::shutdownAll(devices);
+    QMutexLocker locker(&outputMutex_);
+    if (output_.isOpen())
+        output_.flush();
+#ifdef Q_OS_UNIX
+    if (store_)
+        store_->sync();
+#endif
+}
+
+void Daemon::printStats() {
+    const double seconds = std::max<qint64>(statsClock_.restart(), 1) / 1000.0;
+    uint64_t lines;
+    {
+        QMutexLocker locker(&outputMutex_);
+        lines = lines_;
+    }
+    qInfo().noquote() << QString("итого: строк %1 (%2/с)").arg(lines).arg((lines - lastLines_) / seconds, 0, 'f', 1);
+    lastLines_ = lines;
+
+    for (const auto& unit : units_) {
+        const TaskStats task = scheduler_.stats(unit->device.get());
+        const LinkStats link = unit->device->linkStats(); // снимок под BusLock
+        qInfo().noquote() << QString("%1: %2, опросов %3 (%4/с), отказов %5, просрочено %6, "
+                                     "тайм-аутов %7, ошибок CRC %8, повторов %9, объединено %10")
+                                 .arg(QString::fromStdString(unit->name))
+                                 .arg(link.connected ? "на связи" : "нет связи")
+                                 .arg(task.runs)
+                                 .arg((task.runs - unit->lastRuns) / seconds, 0, 'f', 1)
+                                 .arg(task.failures)
+                                 .arg(task.misses)
+                                 .arg(link.timeouts)
+                                 .arg(link.crcErrors)
+                                 .arg(link.retries)
+                                 .arg(link.coalesced);
+        unit->lastRuns = task.runs;
+    }
+}
+
+} // namespace Elemer
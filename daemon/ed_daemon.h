@@ -0,0 +1,98 @@
+#pragma once
+
+#include "ed_samples.h"
+#include "ed_scheduler.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonObject>
+#include <QMutex>
+#include <QObject>
+#include <QTimer>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace Elemer {
+
+class DynamicDevice;
+class ShmPublisher;
+class Store;
+
+/// Автономный сбор данных без GUI. Приборы и периоды опроса читаются из файла JSON:
+///
+///     {
+///         "output": "/var/lib/elemer/data.csv",  // "-" или нет - stdout
+///         "stats": 60,                           // период вывода статистики, с (0 - не выводить)
+///         "reconnect": 5,                        // период повторного поиска отключённых приборов, с
+///         "shm": "/elemer",                      // публикация ReadData в разделяемую память (unix)
+///         "store": "/var/lib/elemer/data.els",   // архив ReadData, ряды (тип << 8 | адрес, канал) (unix)
+///         "devices": [ {
+///             "name": "boiler", "port": "/dev/serial/by-id/...", "baud": 9600,
+///             "type": 75, "address": 1, "rs485": false,
+///             "poll": [
+///                 { "period": 1000 },                               // ReadData всех каналов
+///                 { "period": 60000, "command": 9, "args": [ 1 ] } // произвольная команда
+///             ]
+///         } ]
+///     }
+///
+/// Результаты пишутся строками CSV с разделителем ';':
+/// "время_мс;имя;канал1;...;каналN" для ReadData (пустое поле - нет значения) и
+/// "время_мс;имя;#команда;поле1;...;полеN" для произвольной команды.
+class Daemon : public QObject {
+    Q_OBJECT
+
+public:
+    explicit Daemon(QObject* parent = nullptr);
+    ~Daemon();
+
+    /// чтение конфигурации и открытие выхода; false - ошибка конфигурации.
+    /// Приборы подключаются в start() и далее по таймеру reconnect.
+    bool load(const QString& path);
+    void start();
+    void stop();
+
+signals:
+    void message(const QString&, int timout = {});
+
+private:
+    struct Unit {
+        std::string name;
+        std::unique_ptr<DynamicDevice> device;
+        Samples samples;
+        QString port;
+        int baud {};
+        uint8_t address {};
+        std::atomic<bool> reconnecting {};
+        std::atomic<bool> reported {}; ///< сообщение "не отвечает" выведено, до восстановления связи не повторяется
+        std::array<char, 4096> line {}; ///< строка вывода; задачи прибора выполняются последовательно
+        uint64_t lastRuns {};
+    };
+
+    bool addDevice(const QJsonObject& config);
+    void reconnect();
+    void writeSamples(Unit& unit);
+    void writeReply(Unit& unit, int command, const QByteArray& reply);
+    void write(const char* data, size_t size);
+    void printStats();
+
+    Scheduler scheduler_;
+    std::vector<std::unique_ptr<Unit>> units_;
+#ifdef Q_OS_UNIX
+    std::unique_ptr<ShmPublisher> publisher_;
+    std::unique_ptr<Store> store_;
+#endif
+    QFile output_;
+    QMutex outputMutex_;
+    uint64_t lines_ {};
+    uint64_t lastLines_ {};
+    QTimer flushTimer_;
+    QTimer statsTimer_;
+    QTimer reconnectTimer_;
+    QElapsedTimer statsClock_;
+};
+
+} // namespace Elemer
@@ -0,0 +1,51 @@
+#include "ed_daemon.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QTimer>
+#include <csignal>
+
+using namespace Elemer;
+
+// elemer-daemon --config /etc/elemer-daemon.json
+// формат конфигурации - см. ed_daemon.h
+
+namespace {
+volatile std::sig_atomic_t stopRequested {};
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("elemer-daemon");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Сбор данных с приборов ЭЛЕМЕР без графического интерфейса");
+    parser.addHelpOption();
+    QCommandLineOption configOption({ "c", "config" }, "файл конфигурации JSON", "file");
+    parser.addOption(configOption);
+    parser.process(app);
+
+    if (!parser.isSet(configOption))
+        parser.showHelp(1);
+
+    Daemon daemon;
+    QObject::connect(&daemon, &Daemon::message, [](const QString& msg) { qWarning().noquote() << msg; });
+    if (!daemon.load(parser.value(configOption)))
+        return 1;
+
+    // SIGINT/SIGTERM: обработчик только выставляет флаг, выход - из цикла событий
+    std::signal(SIGINT, [](int) { stopRequested = 1; });
+    std::signal(SIGTERM, [](int) { stopRequested = 1; });
+    QTimer signalTimer;
+    QObject::connect(&signalTimer, &QTimer::timeout, &app, [] {
+        if (stopRequested)
+            QCoreApplication::quit();
+    });
+    signalTimer.start(200);
+
+    daemon.start();
+    const int ret = app.exec();
+    daemon.stop();
+    return ret;
+}
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <QObject>
+#include <array>
 #include <stdint.h>
+#include <string_view>
+#include <utility>
 
 namespace Elemer {
 
@@ -172,6 +175,42 @@ enum DeviceType : uint16_t {
 
 #pragma pack(pop)
 
+namespace detail {
+
+constexpr DeviceInfo findDeviceInfo(size_t tip) noexcept {
+    for (const auto& info : deviceInfo)
+        if (info.Tip == tip)
+            return info;
+    return deviceInfo[0];
+}
+
+template <size_t... Tips>
+constexpr auto makeDeviceTraits(std::index_sequence<Tips...>) noexcept {
+    return std::array<DeviceInfo, sizeof...(Tips)> { findDeviceInfo(Tips)... };
+}
+
+} // namespace detail
+
+/// Таблица характеристик приборов, индексируемая непосредственно значением DeviceType.
+/// Для неизвестных типов содержит запись "Unknown device".
+[[maybe_unused]] static constexpr auto deviceTraits = detail::makeDeviceTraits(std::make_index_sequence<256> {});
+
+/// Характеристики прибора по его типу за O(1)
+constexpr const DeviceInfo& deviceTraitsOf(DeviceType type) noexcept {
+    return type < deviceTraits.size() ? deviceTraits[type] : deviceTraits[UnknownDevice];
+}
+
+/// Характеристики прибора в виде констант времени компиляции
+template <DeviceType Tip>
+struct DeviceTraits {
+    static_assert(Tip < deviceTraits.size(), "DeviceType out of range");
+    static constexpr std::string_view Name { deviceTraits[Tip].Name };
+    static constexpr uint16_t Timeout = deviceTraits[Tip].Timeout;
+    static constexpr uint16_t Channels = deviceTraits[Tip].Channels;
+    static constexpr uint16_t Ustavki = deviceTraits[Tip].Ustavki;
+    static constexpr ProtocolType Protocol = deviceTraits[Tip].Protocol;
+};
+
 enum Baud : uint8_t {
     Baud300,
     Baud600,
@@ -193,7 +232,7 @@ enum class Cmd : uint8_t {
     ReadStatus      = 35, // Команда reads "прочитать значение регистра статуса модуля связи"       Cmd 35 стр.4
     ReadNByte       = 36, // Команда readb "прочитать N байт из буфера возврата модуля связи"       Cmd 36 стр.4
 
-    //SeekRetBuf    = 47, // Команда seekb "установка адреса в буфере возврата "                    Cmd 47 стр.4
+    SeekRetBuf      = 47, // Команда seekb "установка адреса в буфере возврата "                    Cmd 47 стр.4
 
     GetVer          = 0XFE,
     ResetCpu        = 0XFF
@@ -232,6 +271,47 @@ enum class FileCmd : uint8_t {
     // clang-format on
 };
 
+/// Класс команды с точки зрения повтора: чтение без побочных эффектов можно безопасно
+/// повторить, запись и команды, меняющие состояние прибора, - только по явной политике
+enum class CmdClass : uint8_t {
+    Read,
+    Write,
+};
+
+constexpr CmdClass cmdClass(Cmd cmd) noexcept {
+    switch (cmd) {
+    case Cmd::GetDevice:
+    case Cmd::ReadData:
+    case Cmd::ProtocolType:
+    case Cmd::ReadStatus:
+    case Cmd::GetVer:
+        return CmdClass::Read;
+    default:
+        return CmdClass::Write;
+    }
+}
+
+constexpr CmdClass cmdClass(ParamCmd cmd) noexcept {
+    return cmd == ParamCmd::Read ? CmdClass::Read : CmdClass::Write;
+}
+
+constexpr CmdClass cmdClass(FileCmd cmd) noexcept {
+    return cmd == FileCmd::Tell ? CmdClass::Read : CmdClass::Write;
+}
+
+/// класс команды по её числовому коду (для посылок, сформированных вне библиотеки)
+constexpr CmdClass cmdClassOf(uint8_t code) noexcept {
+    if (code >= static_cast<uint8_t>(FileCmd::Open) && code <= static_cast<uint8_t>(FileCmd::Remove))
+        return cmdClass(static_cast<FileCmd>(code));
+    if (code >= static_cast<uint8_t>(ParamCmd::Read) && code <= static_cast<uint8_t>(ParamCmd::Modif))
+        return cmdClass(static_cast<ParamCmd>(code));
+    return cmdClass(static_cast<Cmd>(code));
+}
+
+/// аргументы команды на класс не влияют
+template <typename T>
+constexpr CmdClass cmdClass(const T&) noexcept { return CmdClass::Read; }
+
 enum class Seek : uint8_t {
     Set, // 0 (SEEK_SET) – начало буфера возврата, <origin> - начальная позиция.
     Cur, // 1 (SEEK_CUR) – текущая позиция указателя на буфер возврата
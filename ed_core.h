@@ -0,0 +1,392 @@
+#pragma once
+
+// Ядро протокола ЭЛЕМЕР без зависимостей от Qt: CRC, НЕХ кодек, формирование и разбор посылок.
+// Только заголовочный файл, используется как слоем Device/Port, так и вне Qt (см. ed_fdport.h).
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ELEMER_SSE2
+#endif
+
+namespace Elemer {
+
+/// убирание разделителя из формируемой посылки
+struct SkipSemicolon {
+};
+
+/// добавление разделителя в формируемую посылку
+struct Semicolon {
+};
+
+/// состояние значения канала
+enum class SampleStatus : uint8_t {
+    NoData,      // канал отсутствует в ответе
+    Ok,          // значение получено
+    ParseError,  // поле не преобразуется в число
+    DeviceError, // прибор вернул код ошибки ($nn)
+};
+
+namespace Core {
+
+namespace detail {
+
+    inline constexpr uint8_t tableCrc16Lo[] {
+        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
+        0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
+        0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
+        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
+        0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
+        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
+        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
+        0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
+        0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
+        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
+        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
+        0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
+        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
+        0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
+        0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
+        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40
+    };
+
+    inline constexpr uint8_t tableCrc16Hi[] {
+        0x00, 0xC0, 0xC1, 0x01, 0xC3, 0x03, 0x02, 0xC2, 0xC6, 0x06, 0x07, 0xC7, 0x05, 0xC5, 0xC4, 0x04,
+        0xCC, 0x0C, 0x0D, 0xCD, 0x0F, 0xCF, 0xCE, 0x0E, 0x0A, 0xCA, 0xCB, 0x0B, 0xC9, 0x09, 0x08, 0xC8,
+        0xD8, 0x18, 0x19, 0xD9, 0x1B, 0xDB, 0xDA, 0x1A, 0x1E, 0xDE, 0xDF, 0x1F, 0xDD, 0x1D, 0x1C, 0xDC,
+        0x14, 0xD4, 0xD5, 0x15, 0xD7, 0x17, 0x16, 0xD6, 0xD2, 0x12, 0x13, 0xD3, 0x11, 0xD1, 0xD0, 0x10,
+        0xF0, 0x30, 0x31, 0xF1, 0x33, 0xF3, 0xF2, 0x32, 0x36, 0xF6, 0xF7, 0x37, 0xF5, 0x35, 0x34, 0xF4,
+        0x3C, 0xFC, 0xFD, 0x3D, 0xFF, 0x3F, 0x3E, 0xFE, 0xFA, 0x3A, 0x3B, 0xFB, 0x39, 0xF9, 0xF8, 0x38,
+        0x28, 0xE8, 0xE9, 0x29, 0xEB, 0x2B, 0x2A, 0xEA, 0xEE, 0x2E, 0x2F, 0xEF, 0x2D, 0xED, 0xEC, 0x2C,
+        0xE4, 0x24, 0x25, 0xE5, 0x27, 0xE7, 0xE6, 0x26, 0x22, 0xE2, 0xE3, 0x23, 0xE1, 0x21, 0x20, 0xE0,
+        0xA0, 0x60, 0x61, 0xA1, 0x63, 0xA3, 0xA2, 0x62, 0x66, 0xA6, 0xA7, 0x67, 0xA5, 0x65, 0x64, 0xA4,
+        0x6C, 0xAC, 0xAD, 0x6D, 0xAF, 0x6F, 0x6E, 0xAE, 0xAA, 0x6A, 0x6B, 0xAB, 0x69, 0xA9, 0xA8, 0x68,
+        0x78, 0xB8, 0xB9, 0x79, 0xBB, 0x7B, 0x7A, 0xBA, 0xBE, 0x7E, 0x7F, 0xBF, 0x7D, 0xBD, 0xBC, 0x7C,
+        0xB4, 0x74, 0x75, 0xB5, 0x77, 0xB7, 0xB6, 0x76, 0x72, 0xB2, 0xB3, 0x73, 0xB1, 0x71, 0x70, 0xB0,
+        0x50, 0x90, 0x91, 0x51, 0x93, 0x53, 0x52, 0x92, 0x96, 0x56, 0x57, 0x97, 0x55, 0x95, 0x94, 0x54,
+        0x9C, 0x5C, 0x5D, 0x9D, 0x5F, 0x9F, 0x9E, 0x5E, 0x5A, 0x9A, 0x9B, 0x5B, 0x99, 0x59, 0x58, 0x98,
+        0x88, 0x48, 0x49, 0x89, 0x4B, 0x8B, 0x8A, 0x4A, 0x4E, 0x8E, 0x8F, 0x4F, 0x8D, 0x4D, 0x4C, 0x8C,
+        0x44, 0x84, 0x85, 0x45, 0x87, 0x47, 0x46, 0x86, 0x82, 0x42, 0x43, 0x83, 0x41, 0x81, 0x80, 0x40
+    };
+
+} // namespace detail
+
+/// CRC-16 (X^16 + X^15 + X^2 + 1)
+constexpr uint16_t crc16(std::span<const char> data) noexcept {
+    uint8_t lo8 = 0xFF, hi8 = 0xFF;
+    for (char byte : data) {
+        const uint8_t index = lo8 ^ static_cast<uint8_t>(byte);
+        lo8 = hi8 ^ detail::tableCrc16Lo[index];
+        hi8 = detail::tableCrc16Hi[index];
+    }
+    return static_cast<uint16_t>(hi8 << 8 | lo8);
+}
+
+constexpr int hexDigit(char c) noexcept {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+/// запись байтов в НЕХ формате (верхний регистр); возвращает число символов или 0, если не помещается
+constexpr size_t toHex(std::span<const std::byte> src, std::span<char> dst) noexcept {
+    constexpr char digits[] = "0123456789ABCDEF";
+    if (dst.size() < src.size() * 2)
+        return 0;
+    size_t pos {};
+    for (std::byte b : src) {
+        dst[pos++] = digits[std::to_integer<uint8_t>(b) >> 4];
+        dst[pos++] = digits[std::to_integer<uint8_t>(b) & 0x0F];
+    }
+    return pos;
+}
+
+/// чтение байтов из НЕХ формата; возвращает число байт или -1 при ошибке
+constexpr ptrdiff_t fromHex(std::string_view src, std::span<std::byte> dst) noexcept {
+    if (src.size() % 2 || dst.size() < src.size() / 2)
+        return -1;
+    for (size_t i {}; i < src.size() / 2; ++i) {
+        const int hi = hexDigit(src[i * 2]);
+        const int lo = hexDigit(src[i * 2 + 1]);
+        if (hi < 0 || lo < 0)
+            return -1;
+        dst[i] = static_cast<std::byte>(hi << 4 | lo);
+    }
+    return static_cast<ptrdiff_t>(src.size() / 2);
+}
+
+/// запись числа с разделителем "значение;"; возвращает число символов или 0 при ошибке
+template <typename T>
+inline size_t formatField(std::span<char> out, T val) noexcept
+    requires(std::is_arithmetic_v<T> || std::is_enum_v<T>) {
+    if (out.empty())
+        return 0;
+    std::to_chars_result res;
+    if constexpr (std::is_enum_v<T>)
+        res = std::to_chars(out.data(), out.data() + out.size() - 1, static_cast<long>(val));
+    else if constexpr (std::is_floating_point_v<T>)
+        res = std::to_chars(out.data(), out.data() + out.size() - 1, val, std::chars_format::fixed, 5);
+    else
+        res = std::to_chars(out.data(), out.data() + out.size() - 1, val);
+    if (res.ec != std::errc {})
+        return 0;
+    *res.ptr = ';';
+    return res.ptr - out.data() + 1;
+}
+
+/// преобразование поля ответа в число; false, если поле не является числом целиком
+template <typename T>
+inline bool parse(std::string_view str, T& val) noexcept
+    requires(std::is_arithmetic_v<T> || std::is_enum_v<T>) {
+    const char* const end = str.data() + str.size();
+    std::from_chars_result res;
+    if constexpr (std::is_enum_v<T>) {
+        std::underlying_type_t<T> raw {};
+        res = std::from_chars(str.data(), end, raw);
+        val = static_cast<T>(raw);
+    } else {
+        res = std::from_chars(str.data(), end, val);
+    }
+    return res.ec == std::errc {} && res.ptr == end;
+}
+
+/// Выделение кадра из принятых данных: отбрасывается всё до '!' и начиная с последнего '\r',
+/// сверяется CRC. Возвращает кадр "!адрес;...;CRC" или пустую строку при ошибке.
+constexpr std::string_view checkFrame(std::string_view raw) noexcept {
+    if (auto start = raw.find('!'); start != std::string_view::npos)
+        raw.remove_prefix(start);
+    if (auto end = raw.rfind('\r'); end != std::string_view::npos && end > 0)
+        raw = raw.substr(0, end);
+    const size_t semi = raw.rfind(';');
+    if (semi == std::string_view::npos || semi == 0 || !raw.starts_with('!'))
+        return {};
+    uint32_t crc {};
+    for (char c : raw.substr(semi + 1)) {
+        if (c < '0' || c > '9' || (crc = crc * 10 + (c - '0')) > 0xFFFF)
+            return {};
+    }
+    if (semi + 1 == raw.size() || crc16(raw.substr(1, semi)) != crc)
+        return {};
+    return raw;
+}
+
+/// Вызов func(позиция) для каждого ';' в строке по возрастанию позиций.
+/// При наличии SSE2 строка сравнивается блоками по 16 байт, хвост - побайтно.
+template <typename F>
+constexpr void forEachDelimiter(std::string_view str, F&& func) {
+    size_t i {};
+#ifdef ELEMER_SSE2
+    if (!std::is_constant_evaluated()) {
+        const __m128i semi = _mm_set1_epi8(';');
+        for (; i + 16 <= str.size(); i += 16) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(str.data() + i));
+            for (auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, semi))); mask; mask &= mask - 1)
+                func(i + std::countr_zero(mask));
+        }
+    }
+#endif
+    for (; i < str.size(); ++i) {
+        if (str[i] == ';')
+            func(i);
+    }
+}
+
+/// Обход полей проверенного кадра (адрес, данные..., CRC) без выделения памяти;
+/// возвращает число полей
+template <typename F>
+constexpr size_t forEachField(std::string_view frame, F&& func) {
+    if (frame.starts_with('!'))
+        frame.remove_prefix(1);
+    size_t count {}, pos {};
+    forEachDelimiter(frame, [&](size_t semi) {
+        func(frame.substr(pos, semi - pos));
+        pos = semi + 1;
+        ++count;
+    });
+    func(frame.substr(pos));
+    return count + 1;
+}
+
+namespace detail {
+
+    inline constexpr double exactPow10[] {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    /// Быстрый разбор десятичной записи "[-]цифры[.цифры]". Результат округляется точно:
+    /// мантисса и степень десяти представимы в T без потерь, а одно деление IEEE округляет верно.
+    /// Прочие записи (экспонента, inf/nan, длинная мантисса) - false, их разбирает from_chars.
+    template <typename T>
+    constexpr bool parseDecimal(std::string_view str, T& val) noexcept {
+        const bool negative = str.starts_with('-');
+        uint64_t mantissa {};
+        int digits {}, fraction = -1;
+        for (size_t i = negative; i < str.size(); ++i) {
+            const unsigned digit = static_cast<unsigned char>(str[i]) - '0';
+            if (digit < 10) {
+                mantissa = mantissa * 10 + digit;
+                ++digits;
+                fraction += fraction >= 0;
+            } else if (str[i] == '.' && fraction < 0) {
+                fraction = 0;
+            } else {
+                return false;
+            }
+        }
+        constexpr uint64_t exactMantissa = uint64_t { 1 } << std::numeric_limits<T>::digits;
+        constexpr int exactPower = std::is_same_v<T, float> ? 10 : 22;
+        if (!digits || digits > 19 || mantissa > exactMantissa || fraction > exactPower)
+            return false;
+        T result = static_cast<T>(mantissa);
+        if (fraction > 0)
+            result /= static_cast<T>(exactPow10[fraction]);
+        val = negative ? -result : result;
+        return true;
+    }
+
+} // namespace detail
+
+/// разбор числового поля ответа с классификацией: "$nn" - код ошибки прибора
+template <typename T>
+inline SampleStatus decodeNumber(std::string_view str, T& val) noexcept
+    requires std::is_arithmetic_v<T> {
+    if (str.starts_with('$')) {
+        val = T {};
+        return SampleStatus::DeviceError;
+    }
+    if constexpr (std::is_floating_point_v<T>) {
+        if (detail::parseDecimal(str, val))
+            return SampleStatus::Ok;
+    }
+    if (parse(str, val))
+        return SampleStatus::Ok;
+    val = T {};
+    return SampleStatus::ParseError;
+}
+
+/// Пакетный разбор полей данных проверенного кадра "!адрес;поле1;...;полеN;CRC" в непрерывный
+/// массив values с состоянием каждого поля в status за один проход. Каналы, отсутствующие
+/// в ответе, получают NoData. Возвращает число успешно разобранных полей.
+template <typename T>
+inline size_t decodeNumbers(std::string_view frame, std::span<T> values, std::span<SampleStatus> status) noexcept
+    requires std::is_arithmetic_v<T> {
+    if (frame.starts_with('!'))
+        frame.remove_prefix(1);
+    const size_t count = std::min(values.size(), status.size());
+    size_t field {}, pos {}, decoded {};
+    // поле 0 - адрес, поле после последнего ';' - CRC
+    forEachDelimiter(frame, [&](size_t semi) {
+        if (field && field <= count) {
+            const size_t ch = field - 1;
+            status[ch] = decodeNumber(frame.substr(pos, semi - pos), values[ch]);
+            decoded += status[ch] == SampleStatus::Ok;
+        }
+        pos = semi + 1;
+        ++field;
+    });
+    for (size_t ch = field ? std::min(field - 1, count) : 0; ch < count; ++ch) {
+        values[ch] = T {};
+        status[ch] = SampleStatus::NoData;
+    }
+    return decoded;
+}
+
+/// Формирование посылки "\xFF:поле;...;CRC\r" в фиксированном буфере
+class FrameBuilder {
+public:
+    static constexpr size_t Capacity = 256;
+
+    FrameBuilder() noexcept { buf_[0] = static_cast<char>(-1), buf_[1] = ':'; }
+
+    // FrameBuilder среди аргументов исключён, иначе шаблон перехватывает копирование из неконстантного объекта
+    template <typename... Ts>
+    explicit FrameBuilder(Ts&&... args) noexcept
+        requires(!(std::is_same_v<std::remove_cvref_t<Ts>, FrameBuilder> || ...))
+        : FrameBuilder() {
+        (append(std::forward<Ts>(args)), ...);
+    }
+
+    template <typename T>
+    FrameBuilder& append(T val) noexcept
+        requires(std::is_arithmetic_v<T> || std::is_enum_v<T>) {
+        const size_t n = formatField(std::span(buf_).subspan(size_), val);
+        ok_ &= n > 0;
+        size_ += n;
+        return *this;
+    }
+
+    FrameBuilder& append(std::string_view str) noexcept {
+        if (!reserve(str.size() + 1))
+            return *this;
+        std::memcpy(buf_.data() + size_, str.data(), str.size());
+        size_ += str.size();
+        buf_[size_++] = ';';
+        return *this;
+    }
+
+    FrameBuilder& append(Semicolon) noexcept {
+        if (reserve(1))
+            buf_[size_++] = ';';
+        return *this;
+    }
+
+    FrameBuilder& append(SkipSemicolon) noexcept {
+        if (size_ > 2 && buf_[size_ - 1] == ';')
+            --size_;
+        return *this;
+    }
+
+    /// значения в НЕХ формате одним полем
+    template <typename... Ts>
+    FrameBuilder& appendHex(const Ts&... vals) noexcept {
+        constexpr size_t size = (sizeof(Ts) + ... + 0) * 2;
+        if (!reserve(size + 1))
+            return *this;
+        ((size_ += toHex(std::as_bytes(std::span(&vals, 1)), std::span(buf_).subspan(size_))), ...);
+        buf_[size_++] = ';';
+        return *this;
+    }
+
+    /// добавление CRC и завершающего '\r'
+    FrameBuilder& finish() noexcept {
+        const uint16_t crc = crc16(std::span(buf_.data() + 2, size_ - 2));
+        auto [ptr, ec] = std::to_chars(buf_.data() + size_, buf_.data() + Capacity - 1, crc);
+        ok_ &= ec == std::errc {};
+        if (ok_) {
+            *ptr = '\r';
+            size_ = ptr - buf_.data() + 1;
+        }
+        return *this;
+    }
+
+    bool ok() const noexcept { return ok_; }
+    size_t size() const noexcept { return size_; }
+    std::string_view view() const noexcept { return { buf_.data(), size_ }; }
+
+private:
+    bool reserve(size_t n) noexcept { return ok_ &= size_ + n <= Capacity; }
+
+    std::array<char, Capacity> buf_ {};
+    size_t size_ = 2;
+    bool ok_ = true;
+};
+
+} // namespace Core
+
+} // namespace Elemer
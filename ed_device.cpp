@@ -1,4 +1,13 @@
 #include "ed_device.h"
+#ifdef Q_OS_UNIX
+#include "ed_shm.h"
+#include "ed_store.h"
+#endif
+
+#include <QDebug>
+#include <QDeadlineTimer>
+#include <algorithm>
+#include <cstring>
 
 namespace Elemer {
 
@@ -14,26 +23,93 @@ Device::Device(QObject* parent, DTR dtr, DTS dts)
     connect(this, &Device::open, port_, &Port::Open);
     connect(this, &Device::close, port_, &Port::Close);
     connect(this, &Device::writeParcel, port_, &Port::Write);
+    connect(this, &Device::flushInput, port_, &Port::FlushInput);
     connect(port_, &Port::message, this, &Device::message);
+    connect(port_, &Port::linkLost, this, &Device::linkLost);
+    // любая смена состояния порта делает сохранённые ответы недостоверными
+    connect(port_, &Port::linkLost, this, &Device::invalidateReplies, Qt::DirectConnection);
+    connect(port_, &Port::linkRestored, this, &Device::invalidateReplies, Qt::DirectConnection);
+    connect(port_, &QSerialPort::baudRateChanged, this, &Device::invalidateReplies, Qt::DirectConnection);
+    // состояние связи меняет следующая транзакция под своим BusLock; поток порта
+    // и поток прибора (GUI) только выставляют признак, не ожидая линию
+    connect(
+        port_, &Port::linkRestored, this, [this] { linkRestoredPending_ = true; }, Qt::DirectConnection);
+    connect(port_, &Port::linkRestored, this, &Device::linkRestored);
     portThread_.start(QThread::InheritPriority);
 }
 
 Device::~Device() {
     Timer t(__FUNCTION__);
+    // без ожидания подтверждения: порт закрывается и при удалении Port по завершении потока
+    abort();
     emit close();
-    semaphore_.tryAcquire(1, 2000);
     portThread_.quit();
-    portThread_.wait();
+    // поток порта, не остановленный shutdownAll(), ждём ограниченно: QThread нельзя удалять работающим
+    if (!portThread_.wait(QDeadlineTimer(ShutdownTimeout))) {
+        qWarning() << "Поток порта не завершился за" << ShutdownTimeout.count() << "мс, принудительная остановка";
+        portThread_.terminate();
+        portThread_.wait();
+    }
+}
+
+LinkStats Device::linkStats() {
+    BusLock lock(this);
+    LinkStats stats = linkStats_;
+    stats.connected = connected_;
+    return stats;
+}
+
+void Device::resetLinkStats() {
+    BusLock lock(this);
+    linkStats_ = {};
+}
+
+void Device::setCancelToken(const CancelToken& token) {
+    BusLock lock(this); // токен читают транзакции в потоках планировщика
+    cancelToken_ = token;
+}
+
+void Device::abort() {
+    aborted_ = true;
+    semaphore_.release(); // пробуждение ожидающей транзакции
+}
+
+void Device::resume() {
+    aborted_ = false;
+    semaphore_.acquire(semaphore_.available());
+}
+
+void Device::abortAll(std::span<Device* const> devices) {
+    for (Device* device : devices)
+        device->abort();
+}
+
+bool Device::shutdownAll(std::span<Device* const> devices, std::chrono::milliseconds timeout) {
+    const QDeadlineTimer deadline(timeout);
+    abortAll(devices);
+    for (Device* device : devices) {
+        emit device->close();
+        device->portThread_.quit();
+    }
+    bool stopped = true;
+    for (Device* device : devices)
+        stopped &= device->portThread_.wait(deadline);
+    return stopped;
 }
 
 bool Device::ping(const QString& portName, int baud, int addr) {
     QMutexLocker locker(&mutex_);
+    BusLock lock(this); // переоткрытие порта не пересекается с транзакциями планировщика
+    if (isAborted())
+        return connected_ = false;
 
     connected_ = true;
+    linkStats_.consecutiveFailures = 0;
+    invalidateReplies();
     semaphore_.acquire(semaphore_.available());
     do {
         emit close();
-        if (!semaphore_.tryAcquire(1, 10000)) // ждём закрытия порта
+        if (!acquireReply(10000)) // ждём закрытия порта
             break;
 
         if (!portName.isEmpty())
@@ -45,10 +121,11 @@ bool Device::ping(const QString& portName, int baud, int addr) {
 #endif
         if constexpr (Policy::value) {
             emit open(QIODevice::ReadWrite);
-            if (!(semaphore_.tryAcquire(1, 2000) && port_->isOpen()))
+            if (!(acquireReply(2000) && port_->isOpen()))
                 break;
             port_->setDataTerminalReady(dtr == DTR::On);
-            port_->setRequestToSend(dts == DTS::On);
+            if (!port_->halfDuplex())
+                port_->setRequestToSend(dts == DTS::On);
             portThread_.msleep(50);
         }
 
@@ -67,10 +144,12 @@ DeviceType Device::getType(int addr) {
 #ifdef EL_EMU
     return type();
 #endif
+    BusLock lock(this);
     Policy(this);
     if (isConnected()) {
-        emit writeParcel(makeParcel(addr, Cmd::GetDevice));
-        if (wait(1000)) {
+        invalidateReplies(); // проверка связи всегда обращается к линии
+        makeParcel(addr, Cmd::GetDevice);
+        if (exchange(1000)) {
             m_address = m_data[0].to<int>();
             return static_cast<DeviceType>(m_data[1].to<int>());
         }
@@ -85,58 +164,174 @@ bool Device::success() {
     return !m_lastRetCode && m_data[1].startsWith('$');
 }
 
+bool Device::checkCrc() {
+    const auto frame = Core::checkFrame({ rcData_.constData(), static_cast<size_t>(rcData_.size()) });
+    if (frame.empty())
+        return false;
+    // в rcData_ остаётся только кадр "!...;CRC"
+    const int offset = static_cast<int>(frame.data() - rcData_.constData());
+    rcData_.resize(offset + static_cast<int>(frame.size()));
+    rcData_.remove(0, offset);
+    return true;
+}
+
 bool Device::checkParcel() {
-    if (int index = rcData_.indexOf('!'); index > 0)
-        rcData_.remove(0, index);
-
-    if (int index = rcData_.lastIndexOf('\r'); index > 0)
-        rcData_.resize(index);
-
-    if (int index = rcData_.lastIndexOf(';') + 1;
-        index > 0 && calcCrc(rcData_.left(index), 1).toUInt() == rcData_.right(rcData_.length() - index).toUInt()) {
-        m_data.clear();
-        index = 0;
-        int lastIndex;
-        do {
-            index = rcData_.indexOf(';', index + 1);
-            m_data.empty() ? m_data.emplace_back(rcData_.data() + 1, index - 1)
-                           : m_data.emplace_back(rcData_.data() + lastIndex, index - lastIndex);
-            lastIndex = index + 1;
-        } while (index > -1);
-        return true;
-    }
     m_data.clear();
-    return false;
+    if (!checkCrc())
+        return false;
+    char* const data = rcData_.data();
+    Core::forEachField({ data, static_cast<size_t>(rcData_.size()) }, [this, data](std::string_view field) {
+        m_data.emplace_back(data + (field.data() - data), field.size());
+    });
+    return true;
 }
 
-bool Device::wait(int timeout) {
-    if (connected_ && semaphore_.tryAcquire(1, timeout)) {
-        if (checkParcel())
-            return true;
-        else
-            emit message("Ошибка контрольной суммы.");
-    } else {
+bool Device::checkAddress() const {
+    // ответ "!адрес;..." на посылку "\xFF:адрес;..."; адрес 0 - общий, отвечает любой прибор
+    const auto address = [](const QByteArray& frame, int from) {
+        const int end = frame.indexOf(';', from);
+        int value = -1;
+        if (end > from)
+            Core::parse(std::string_view { frame.constData() + from, static_cast<size_t>(end - from) }, value);
+        return value;
+    };
+    const int request = address(parcel.data, 2);
+    return request == 0 || (request > 0 && request == address(rcData_, 1));
+}
+
+bool Device::exchange(int timeout, bool split, const CancelToken* cancel) {
+    CancelScope scope(this, cancel);
+    if (isAborted())
+        return false;
+    // запись могла изменить читаемые значения, даже если ответ на неё не получен
+    if (cacheStale_.exchange(false) || parcelClass_ == CmdClass::Write)
+        replyCache_.clear();
+    if (parcelClass_ == CmdClass::Read && connected_) {
+        auto it = replyCache_.constFind(parcel.data);
+        if (it != replyCache_.cend() && (it->received >= requestTime_ || clock::now() - it->received <= coalesceWindow_)) {
+            rcData_ = it->reply;
+            ++linkStats_.coalesced;
+            return split ? checkParcel() : checkCrc();
+        }
+    }
+    // ответы и признаки ответов, оставшиеся от прошлых транзакций (опоздавшие после
+    // таймаута, повторные), не должны быть приняты за ответ на эту посылку
+    semaphore_.acquire(semaphore_.available());
+    emit flushInput();
+    emit writeParcel(parcel);
+    if (!wait(timeout, split)) {
+        dropBoost();
+        return false;
+    }
+    if (parcelClass_ == CmdClass::Read) {
+        if (replyCache_.size() >= 64)
+            replyCache_.clear();
+        replyCache_.insert(parcel.data, { rcData_, clock::now() });
+    }
+    return true;
+}
+
+bool Device::wait(int timeout, bool split) {
+    if (!connected_)
+        return {};
+    const RetryPolicy& policy = retryPolicy(parcelClass_);
+    int backoff = policy.backoff;
+    ++linkStats_.transactions;
+    for (int attempt = 1;; ++attempt) {
+        // при отмене порт не трогается: при завершении его поток может быть уже остановлен
+        const bool received = !isAborted() && !port_->unplugged() && acquireReply(timeout);
+        if (isAborted() || port_->unplugged()) { // отмена или адаптер отключён - без повторов
+            ++linkStats_.failures;
+            return {};
+        }
+        if (received) {
+            rcData_ = port_->takeReply(); // кадр копируется в потоке транзакции
+            if (!(split ? checkParcel() : checkCrc())) {
+                ++linkStats_.crcErrors;
+                emit message("Ошибка контрольной суммы.");
+            } else if (!checkAddress()) {
+                ++linkStats_.mismatches;
+                emit message("Ответ с чужим адресом отброшен.");
+            } else {
+                linkStats_.consecutiveFailures = 0;
+                return true;
+            }
+        } else {
+            ++linkStats_.timeouts;
+            emit message("Превышено время ожидания ответа.");
+        }
+        if (attempt >= policy.attempts)
+            break;
+        // сброс входного буфера и повтор той же посылки
+        ++linkStats_.retries;
+        QThread::msleep(backoff);
+        backoff = std::min(backoff * 2, policy.maxBackoff);
+        emit flushInput();
+        emit writeParcel(parcel);
+    }
+    ++linkStats_.failures;
+    if (countFailure_ && ++linkStats_.consecutiveFailures >= offlineThreshold_) {
         connected_ = false;
-        emit message("Превышено время ожидания ответа.");
+        emit message("Прибор не отвечает, связь потеряна.");
     }
     return {};
 }
 
+bool Device::acquireReply(int timeout) {
+    const QDeadlineTimer deadline(timeout);
+    while (!isAborted()) {
+        const qint64 left = deadline.remainingTime(); // -1 - без ограничения
+        const int slice = left < 0 ? CancelSlice : static_cast<int>(std::min<qint64>(left, CancelSlice));
+        if (semaphore_.tryAcquire(1, slice))
+            return true;
+        if (deadline.hasExpired())
+            return false;
+    }
+    return false;
+}
+
 QByteArray Device::calcCrc(const QByteArray& parcel, size_t offset) {
-    // (X^16 + X^15 + X^2 + 1).
-    union {
-        struct {
-            uint8_t lo8;
-            uint8_t hi8;
-        };
-        uint16_t crc16;
-    } crc = { .crc16 = 0xFFFF };
-    for (auto byte : std::span(parcel.data() + offset, parcel.size() - offset)) {
-        uint8_t index = crc.lo8 ^ byte;
-        crc.lo8 = crc.hi8 ^ tableCrc16Lo[index];
-        crc.hi8 = tableCrc16Hi[index];
+    return QByteArray::number(crc16(parcel.data() + offset, parcel.size() - offset));
+}
+
+uint16_t Device::crc16(const char* data, size_t size) noexcept {
+    return Core::crc16({ data, size });
+}
+
+uint8_t Device::rawCommand(const QByteArray& frame) {
+    // код команды - второе поле посылки "\xFF:адрес;команда;..."; неразобранная считается записью
+    uint8_t code = static_cast<uint8_t>(FileCmd::Write);
+    if (frame.size() < 4)
+        return code;
+    size_t field {};
+    Core::forEachField({ frame.constData() + 2, static_cast<size_t>(frame.size()) - 2 }, [&](std::string_view str) {
+        if (field++ == 1)
+            Core::parse(str, code);
+    });
+    return code;
+}
+
+bool Device::changesLink(uint8_t code) {
+    return code == static_cast<uint8_t>(Cmd::SetAddress) || code == static_cast<uint8_t>(Cmd::SetBaudRate);
+}
+
+QByteArray Device::transactRaw(const QByteArray& frame, int timeout, bool countFailure, const CancelToken* cancel) {
+    BusLock lock(this);
+    CancelScope scope(this, cancel);
+    Policy(this);
+    const uint8_t code = rawCommand(frame);
+    if (!isConnected() || frame.size() < 4)
+        return {};
+    if (changesLink(code)) {
+        emit message("Смена адреса или скорости - только через setAddress()/setBaudRate().");
+        return {};
     }
-    return QByteArray::number(crc.crc16);
+    parcelClass_ = cmdClassOf(code);
+    parcel.data = frame;
+    countFailure_ = countFailure;
+    const bool ok = exchange(timeout, false);
+    countFailure_ = true;
+    return ok ? rcData_ + '\r' : QByteArray {};
 }
 
 Port* Device::port() const { return port_; }
@@ -159,6 +354,173 @@ bool Device::setBaudRate(Baud baudRate) {
     return success;
 }
 
+int Device::exchangeData(std::span<float> values, std::span<SampleStatus> status) {
+    BusLock lock(this);
+    Policy(this);
+    if (!isConnected())
+        return -1;
+    makeParcel(m_address, Cmd::ReadData);
+    if (!exchange(3000, false)) { // кадр разбирается пакетно, без выделения полей в m_data
+        std::fill(values.begin(), values.end(), 0.0f);
+        std::fill(status.begin(), status.end(), SampleStatus::NoData);
+        return -1;
+    }
+    return static_cast<int>(Core::decodeNumbers({ rcData_.constData(), static_cast<size_t>(rcData_.size()) }, values, status));
+}
+
+bool Device::readData(Samples& samples) {
+    BusLock lock(this);
+    const int decoded = exchangeData(samples.values, samples.status);
+    if (decoded < 0)
+        return false;
+    samples.stamp();
+    const bool okAll = decoded == static_cast<int>(samples.channels());
+    if (history_)
+        history_->append(samples);
+#ifdef Q_OS_UNIX
+    if (publisher_)
+        publisher_->publish(publisherSlot_, type(), m_address, samples);
+    if (store_)
+        store_->append(storeDevice_, samples);
+#endif
+    return okAll;
+}
+
+int Device::retBufAvailable() {
+    Policy(this);
+    int available {};
+    bool success = isConnected() && read<Cmd::ReadStatus>(available);
+    return success ? available : -1;
+}
+
+bool Device::retBufSeek(uint16_t offset, Seek seek) {
+    Policy(this);
+    bool success = isConnected() && write<Cmd::SeekRetBuf>(offset, seek) == RetCcode::Ok;
+    return success;
+}
+
+int Device::takeHexData(char* dst, int size) const {
+    // "$nn" - код ошибки прибора; данные декодируются строго, без пропуска символов
+    const Span& field = m_data[1];
+    if (!field.data.empty() && field.data[0] == '$')
+        return -1;
+    std::array<std::byte, MaxNByte> data;
+    const ptrdiff_t count = Core::fromHex({ field.data.data(), field.data.size() }, data);
+    if (count < 0 || count > size)
+        return -1;
+    std::memcpy(dst, data.data(), count);
+    return static_cast<int>(count);
+}
+
+qint64 Device::readRetBuf(std::span<char> dst) {
+    BusLock lock(this);
+    Policy(this);
+    qint64 total {};
+    int available = retBufAvailable();
+    if (available < 0)
+        return -1;
+    // статус перезапрашивается только после выборки известного количества байт,
+    // а не перед каждым блоком
+    while (available > 0 && total < static_cast<qint64>(dst.size())) {
+        const int chunk = static_cast<int>(std::min<qint64>({ available, MaxNByte, static_cast<qint64>(dst.size()) - total }));
+        makeParcel(m_address, Cmd::ReadNByte, chunk);
+        if (!exchange() || m_data.size() < 3)
+            return total ? total : -1;
+        // пустой ответ при ненулевом остатке в буфере - ошибка
+        const int size = takeHexData(dst.data() + total, chunk);
+        if (size <= 0)
+            return total ? total : -1;
+        total += size;
+        if ((available -= size) <= 0 && total < static_cast<qint64>(dst.size()))
+            available = retBufAvailable();
+    }
+    return total;
+}
+
+Baud Device::baudRate() const {
+    const auto it = std::find(std::begin(stdBauds), std::end(stdBauds), port_->baudRate());
+    return it == std::end(stdBauds) ? Baud9600 : static_cast<Baud>(it - std::begin(stdBauds));
+}
+
+bool Device::verifyLink(int attempts) {
+    BusLock lock(this);
+    while (attempts--) {
+        connected_ = true;
+        if (getType(m_address) != type())
+            return connected_ = false;
+    }
+    return true;
+}
+
+bool Device::restoreBaudRate(Baud from, Baud to) {
+    BusLock lock(this);
+    connected_ = true;
+    port_->setBaudRate(stdBauds[from]);
+    if (!setBaudRate(to)) // прибор мог переключиться, не успев ответить
+        port_->setBaudRate(stdBauds[to]);
+    return verifyLink(1);
+}
+
+Baud Device::upshiftBaudRate(Baud maxBaud) {
+    Timer t(__FUNCTION__);
+    BusLock lock(this); // опрос на промежуточной скорости засчитывал бы отказы
+    const Baud initial = baudRate();
+#ifdef EL_EMU
+    return initial;
+#endif
+    Policy(this);
+    for (Baud baud = maxBaud; baud > initial; baud = static_cast<Baud>(baud - 1)) {
+        connected_ = true;
+        const bool acked = setBaudRate(baud);
+        if (!acked)
+            port_->setBaudRate(stdBauds[baud]); // ответ мог потеряться после переключения прибора
+        if (verifyLink())
+            return baud;
+        emit message(QString("Скорость %1 не поддерживается, возврат на %2.").arg(stdBauds[baud]).arg(stdBauds[initial]));
+        if (!restoreBaudRate(baud, initial))
+            break;
+    }
+    connected_ = true;
+    port_->setBaudRate(stdBauds[initial]);
+    verifyLink(1);
+    return initial;
+}
+
+BaudBoost::BaudBoost(Device* device, Baud maxBaud)
+    : pDevice { device }
+    , lock { device ? std::unique_lock(device->busMutex_) : std::unique_lock<QRecursiveMutex> {} }
+    , configured { device ? device->baudRate() : Baud9600 }
+    , active { configured } {
+    if (pDevice && pDevice->isConnected())
+        active = pDevice->upshiftBaudRate(maxBaud);
+    if (pDevice && active != configured)
+        pDevice->boost_ = this;
+}
+
+BaudBoost::~BaudBoost() {
+    if (!pDevice)
+        return;
+    pDevice->boost_ = nullptr;
+    if (active == configured)
+        return;
+    pDevice->connected_ = true;
+    if (!pDevice->setBaudRate(configured))
+        pDevice->restoreBaudRate(active, configured);
+}
+
+void Device::dropBoost() {
+    // прибор, переставший отвечать на повышенной скорости, возвращается на исходную сразу,
+    // не дожидаясь конца BaudBoost
+    BaudBoost* boost = std::exchange(boost_, nullptr);
+    if (!boost || isAborted())
+        return;
+    emit message(QString("Ошибка обмена на скорости %1, возврат на %2.")
+                     .arg(stdBauds[boost->active])
+                     .arg(stdBauds[boost->configured]));
+    restoreBaudRate(boost->active, boost->configured);
+    boost->active = boost->configured;
+}
+
 bool Device::fileOpen() {
     Policy(this);
     bool success = isConnected() && write<FileCmd::Open>() == RetCcode::Ok;
@@ -177,6 +539,28 @@ bool Device::fileSeek(uint16_t offset, Seek seek) {
     return success;
 }
 
+int Device::fileReadBytes(char* dst, int size, const CancelToken* cancel) {
+    BusLock lock(this);
+    CancelScope scope(this, cancel);
+    Policy(this);
+    size = std::clamp(size, 0, MaxFileChunk);
+    if (!isConnected())
+        return -1;
+    makeParcel(m_address, FileCmd::Read, size);
+    if (!exchange() || m_data.size() < 3)
+        return -1;
+    return takeHexData(dst, size); // пусто - конец файла
+}
+
+bool Device::fileWriteBytes(const char* src, int size, const CancelToken* cancel) {
+    if (size <= 0 || size > MaxFileChunk)
+        return false;
+    CancelScope scope(this, cancel);
+    Policy(this);
+    bool success = isConnected() && writeHex<FileCmd::Write>(QByteArray::fromRawData(src, size)) == RetCcode::Ok;
+    return success;
+}
+
 ////////////////////////////////////////////////////////////
 /// \brief PortOpener::PortOpener
 /// \param ad
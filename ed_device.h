@@ -1,20 +1,32 @@
 #pragma once
 
 #include "ed_common_types.h"
+#include "ed_history.h"
 #include "ed_port.h"
+#include "ed_response.h"
+#include "ed_samples.h"
 #include "ed_utils.h"
 //my
 #include <commoninterfaces.h>
 //Qt
+#include <QHash>
+#include <QRecursiveMutex>
 #include <QSemaphore>
 #include <QThread>
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <concepts>
+#include <mutex>
 
 using namespace std::chrono_literals;
 
 namespace Elemer {
 
+class BaudBoost;
+class ShmPublisher;
+class Store;
+
 enum class DTR : bool {
     Off,
     On,
@@ -25,10 +37,46 @@ enum class DTS : bool {
     On,
 };
 
+/// Признак отмены транзакций; копии разделяют один флаг, поэтому один токен может
+/// останавливать группу приборов (линию, всё приложение)
+class CancelToken {
+public:
+    CancelToken()
+        : flag_ { std::make_shared<std::atomic<bool>>() } { }
+
+    void cancel() noexcept { flag_->store(true, std::memory_order_relaxed); }
+    void reset() noexcept { flag_->store(false, std::memory_order_relaxed); }
+    bool isCancelled() const noexcept { return flag_->load(std::memory_order_relaxed); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag_;
+};
+
+/// Политика повтора транзакции при отсутствии ответа или ошибке контрольной суммы
+struct RetryPolicy {
+    int attempts = 3;     ///< общее число попыток
+    int backoff = 20;     ///< пауза перед первым повтором, мс (удваивается)
+    int maxBackoff = 200; ///< наибольшая пауза, мс
+};
+
+/// Счётчики ошибок обмена с прибором
+struct LinkStats {
+    uint64_t transactions {};
+    uint64_t timeouts {};
+    uint64_t crcErrors {};
+    uint64_t retries {};
+    uint64_t failures {}; ///< транзакции, не завершившиеся успешно после всех попыток
+    uint64_t coalesced {}; ///< запросы чтения, обслуженные без обращения к линии
+    uint64_t mismatches {}; ///< отброшенные ответы с адресом, отличным от адреса посылки
+    int consecutiveFailures {};
+    bool connected {}; ///< состояние связи на момент снимка Device::linkStats()
+};
+
 class Device : public QObject, public CommonInterfaces {
     Q_OBJECT
     friend class Port;
     friend class CloseAfterRaad;
+    friend class BaudBoost;
 
 public:
     using Policy = AlwaysOpen;
@@ -36,19 +84,126 @@ public:
     ~Device();
 
     virtual DeviceType type() const = 0;
+    const DeviceInfo& info() const { return deviceTraitsOf(type()); }
     bool ping(const QString& portName = {}, int baud = 9600, int addr = 0) override;
 
     DeviceType getType(int addr);
 
     bool success();
     bool checkParcel();
+    /// проверка контрольной суммы принятой посылки без разбиения на поля
+    bool checkCrc();
+    /// адрес ответа совпадает с адресом посылки
+    bool checkAddress() const;
 
     QByteArray calcCrc(const QByteArray& parcel, size_t offset = 0);
+    static uint16_t crc16(const char* data, size_t size) noexcept;
 
     Port* port() const;
     uint8_t address() const;
+
+    void setRetryPolicy(CmdClass cmdClass, const RetryPolicy& policy) { retryPolicy_[static_cast<int>(cmdClass)] = policy; }
+    const RetryPolicy& retryPolicy(CmdClass cmdClass) const { return retryPolicy_[static_cast<int>(cmdClass)]; }
+    /// число подряд неудачных транзакций, после которого прибор считается отключённым
+    void setOfflineThreshold(int threshold) { offlineThreshold_ = std::max(1, threshold); }
+    /// Снимок счётчиков и состояния связи; счётчики меняются транзакциями в потоках
+    /// планировщика, поэтому снимок ждёт завершения текущей транзакции (BusLock)
+    LinkStats linkStats();
+    /// Интервал, в течение которого ответ на запрос чтения выдаётся повторно без обращения
+    /// к линии; 0 - объединяются только запросы, ожидавшие выполнения одинакового запроса
+    void setCoalesceWindow(std::chrono::milliseconds window) { coalesceWindow_ = window; }
+    void resetLinkStats();
+
+    /// Общий признак отмены: пока он выставлен, транзакции прибора завершаются ошибкой,
+    /// ожидание ответа прерывается не позже чем через CancelSlice. Замена выполняется под BusLock.
+    void setCancelToken(const CancelToken& token);
+    const CancelToken& cancelToken() const { return cancelToken_; }
+    /// Немедленная отмена текущей и последующих транзакций прибора до resume()
+    void abort();
+    void resume();
+    bool isAborted() const {
+        const CancelToken* operation = operationCancel_.load(std::memory_order_relaxed);
+        return aborted_.load(std::memory_order_relaxed) || cancelToken_.isCancelled()
+            || (operation && operation->isCancelled());
+    }
+
+    /// Отмена одной операции (передача файла, посылка клиента) без остановки опроса прибора:
+    /// на время существования захватывает линию (BusLock) и добавляет token к признакам отмены
+    /// транзакций этого потока. token == nullptr - только захват линии.
+    class CancelScope {
+        Device* const pDevice;
+        std::unique_lock<QRecursiveMutex> lock;
+        const CancelToken* const outer;
+        const bool active;
+
+    public:
+        CancelScope(Device* device, const CancelToken* token)
+            : pDevice { device }
+            , lock { device->busMutex_ }
+            , outer { device->operationCancel_.load(std::memory_order_relaxed) }
+            , active { token != nullptr } {
+            if (active)
+                pDevice->operationCancel_.store(token, std::memory_order_relaxed);
+        }
+        ~CancelScope() {
+            if (active)
+                pDevice->operationCancel_.store(outer, std::memory_order_relaxed);
+        }
+        CancelScope(const CancelScope&) = delete;
+        CancelScope& operator=(const CancelScope&) = delete;
+    };
+
+    /// отмена транзакций группы приборов без остановки потоков портов
+    static void abortAll(std::span<Device* const> devices);
+    /// Завершение группы приборов одновременно: отмена транзакций, закрытие портов и
+    /// остановка их потоков параллельно, общее время не больше timeout.
+    /// Возвращает true, если все потоки портов остановлены; после этого приборы можно только удалить,
+    /// их деструкторы не ждут. Потоки, выполняющие транзакции приборов (Scheduler), должны быть
+    /// остановлены раньше: abortAll() -> Scheduler::stop() -> shutdownAll().
+    static bool shutdownAll(std::span<Device* const> devices, std::chrono::milliseconds timeout = 2s);
+
+    /// ожидание остановки потока порта в деструкторе
+    static constexpr std::chrono::milliseconds ShutdownTimeout = 2s;
+    /// наибольший интервал проверки отмены при ожидании ответа, мс
+    static constexpr int CancelSlice = 20;
     bool setAddress(uint8_t address);
     bool setBaudRate(Baud baudRate);
+    /// Текущая скорость порта
+    Baud baudRate() const;
+
+    /// Переход на наибольшую скорость не выше maxBaud, на которой прибор отвечает на GetDevice;
+    /// при ошибках возврат на исходную скорость. Возвращает установленную скорость.
+    Baud upshiftBaudRate(Baud maxBaud = Baud19200);
+
+    /// Буфер измерений на все каналы прибора
+    Samples makeSamples() const { return Samples(info().Channels); }
+
+    /// Чтение измеряемых величин всех каналов за одну транзакцию в заранее выделенный буфер
+    bool readData(Samples& samples);
+
+    /// История измерений, пополняемая при каждом успешном readData() (nullptr - не вести)
+    void setHistory(History* history) { history_ = history; }
+    History* history() const { return history_; }
+
+    /// Публикация результатов readData() в разделяемую память под номером slot (только unix)
+    void setPublisher(ShmPublisher* publisher, uint32_t slot) { publisher_ = publisher, publisherSlot_ = slot; }
+
+    /// Запись результатов readData() в архив рядами (seriesDevice, канал) (только unix)
+    void setStore(Store* store, uint32_t seriesDevice) { store_ = store, storeDevice_ = seriesDevice; }
+
+    /// Максимальное число байт, запрашиваемое одной командой ReadNByte
+    /// (ответ в НЕХ формате должен уместиться в посылку длиной 255 символов)
+    static constexpr int MaxNByte = 120;
+
+    /// Число байт, доступных в буфере возврата модуля связи (ReadStatus), -1 при ошибке
+    int retBufAvailable();
+
+    /// Установка позиции в буфере возврата модуля связи
+    bool retBufSeek(uint16_t offset = 0, Seek seek = Seek::Set);
+
+    /// Чтение буфера возврата модуля связи блоками максимального размера в dst;
+    /// возвращает число прочитанных байт или -1, если не прочитано ничего из-за ошибки
+    qint64 readRetBuf(std::span<char> dst);
 
     /// Открытие файла
     bool fileOpen();
@@ -77,6 +232,16 @@ public:
         return success;
     }
 
+    /// Наибольший блок данных файла в одной посылке FileCmd::Read/FileCmd::Write
+    static constexpr int MaxFileChunk = MaxNByte;
+
+    /// Чтение до size байт (не более MaxFileChunk) с текущей позиции файла;
+    /// возвращает число прочитанных байт или -1 при ошибке (в том числе отмене cancel)
+    int fileReadBytes(char* dst, int size, const CancelToken* cancel = nullptr);
+
+    /// Запись size байт (не более MaxFileChunk) по текущей позиции файла
+    bool fileWriteBytes(const char* src, int size, const CancelToken* cancel = nullptr);
+
     bool fileTell();
     bool fileChMod();
     bool fileRemove();
@@ -84,9 +249,10 @@ public:
     /// Запись в устройство с преобразованием в НЕХ формат
     template <auto... Cmds, typename... Ts>
     inline int writeHex(Ts&&... vars) requires(is_command<decltype(Cmds)>&&... && true) {
+        BusLock lock(this);
         Policy(this);
-        emit writeParcel(makeParcel(m_address, Cmds..., ToHex { std::forward<Ts>(vars)... }));
-        if (wait())
+        makeParcel(m_address, Cmds..., ToHex { std::forward<Ts>(vars)... });
+        if (exchange())
             return m_lastRetCode = m_data[1].startsWith('$') ? m_data[1].mid(1).to<int>() : int {};
         return -1;
     }
@@ -96,14 +262,16 @@ public:
     inline bool readHex(Ret&... ret) requires(is_command<decltype(Cmds)>&&... && true) {
         constexpr size_t packSize = (sizeof(Ret) + ... + 0);
         constexpr size_t cmdsSize = sizeof...(Cmds);
+        BusLock lock(this);
         if constexpr (cmdsSize > 0) {
             Policy(this);
-            emit writeParcel(makeParcel(m_address, Cmds...));
+            makeParcel(m_address, Cmds...);
         }
-        if ((cmdsSize == 0 || wait()) && m_data[1].size() == packSize * 2) {
+        if ((cmdsSize == 0 || exchange()) && m_data.size() > 1 && m_data[1].size() == packSize * 2) {
             int ctr {};
-            ((FromHex { ret } = m_data[1].mid(ctr, sizeof(Ret) * 2), ctr += sizeof(Ret) * 2), ...);
-            return true;
+            bool ok = true;
+            ((ok = (FromHex { ret } = m_data[1].mid(ctr, sizeof(Ret) * 2)).ok && ok, ctr += sizeof(Ret) * 2), ...);
+            return ok;
         }
         return false;
     }
@@ -111,9 +279,10 @@ public:
     /// Запись в устройство с преобразованием в строчный формат
     template <auto... Cmds, typename... Ts>
     inline int write(Ts&&... vars) requires(is_command<decltype(Cmds)>&&... && true) {
+        BusLock lock(this);
         Policy(this);
-        emit writeParcel(makeParcel(m_address, Cmds..., std::forward<Ts>(vars)...));
-        if (wait())
+        makeParcel(m_address, Cmds..., std::forward<Ts>(vars)...);
+        if (exchange())
             return m_lastRetCode = m_data[1].mid(1).to<int>();
         return -1;
     }
@@ -123,11 +292,12 @@ public:
     inline bool read(Ret&... ret) requires(is_command<decltype(Cmds)>&&... && true) {
         constexpr size_t cmdsSize = sizeof...(Cmds);
         constexpr size_t dataize = sizeof...(Ret);
+        BusLock lock(this);
         if constexpr (cmdsSize > 0) {
             Policy(this);
-            emit writeParcel(makeParcel(m_address, Cmds...));
+            makeParcel(m_address, Cmds...);
         }
-        if ((cmdsSize == 0 || wait()) && dataize && m_data.size() >= (dataize + 2)) {
+        if ((cmdsSize == 0 || exchange()) && dataize && m_data.size() >= (dataize + 2)) {
             int ctr {};
             bool okAll = true;
             ((okAll &= (FromStr { ret } = m_data[1 + ctr++]).ok), ...);
@@ -136,9 +306,35 @@ public:
         return false;
     }
 
+    /// Чтение из устройства с разбором ответа по схеме Response<...> за один проход
+    template <auto... Cmds, typename... Fields>
+    inline bool read(Response<Fields...>& response) requires(is_command<decltype(Cmds)>&&... && true) {
+        constexpr size_t cmdsSize = sizeof...(Cmds);
+        BusLock lock(this);
+        if constexpr (cmdsSize > 0) {
+            Policy(this);
+            makeParcel(m_address, Cmds...);
+        }
+        return (cmdsSize == 0 || exchange(3000, false))
+            && response.decode({ rcData_.constData(), static_cast<size_t>(rcData_.size()) });
+    }
+
+    /// Передача готовой посылки (с CRC и '\r') без изменений и возврат ответа
+    /// в том же виде; пустой массив при ошибке. Повтор - по политике для класса команды.
+    /// countFailure == false - отказ не учитывается в порог offlineThreshold (посылки
+    /// сторонних клиентов не должны переводить прибор в состояние "нет связи").
+    /// Команды changesLink() не передаются: адрес и скорость порта не были бы обновлены.
+    QByteArray transactRaw(const QByteArray& frame, int timeout = 3000, bool countFailure = true,
+        const CancelToken* cancel = nullptr);
+    /// код команды готовой посылки
+    static uint8_t rawCommand(const QByteArray& frame);
+    /// команда меняет адрес или скорость прибора (SetAddress, SetBaudRate)
+    static bool changesLink(uint8_t code);
+
     /// Формирование посылки для отправки в устройство
     template <typename... Ts>
     Parcel& makeParcel(Ts&&... args) {
+        parcelClass_ = ((cmdClass(args) == CmdClass::Write) || ...) ? CmdClass::Write : CmdClass::Read;
         parcel = Parcel(std::forward<Ts>(args)...);
         parcel.data.append(calcCrc(parcel.data, 2)).append('\r');
         return parcel;
@@ -155,13 +351,15 @@ public:
     /// преобразование из НЕХ формата
     template <typename T>
     auto fromHex(const QByteArray& data, bool* ok = nullptr) requires hex_convertible<T> {
-        auto d = QByteArray::fromHex(data);
-        if (d.size() != sizeof(T)) {
+        std::array<std::byte, sizeof(T)> d;
+        if (Core::fromHex({ data.constData(), static_cast<size_t>(data.size()) }, d) != static_cast<ptrdiff_t>(sizeof(T))) {
             ok ? (*ok = false) : false;
             return T {};
         }
         ok ? (*ok = true) : true;
-        return *reinterpret_cast<T*>(const_cast<char*>(d.data()));
+        T val;
+        std::memcpy(&val, d.data(), sizeof(T));
+        return val;
     }
 
     static void waitAllReset() { waitAllSemaphore.acquire(waitAllSemaphore.available()); }
@@ -171,10 +369,59 @@ signals:
     void open(int mode) override;
     void close() override;
     void writeParcel(const Elemer::Parcel& data);
+    void flushInput();
     void message(const QString&, int timout = {});
+    /// адаптер порта отключён; транзакции завершаются ошибкой до его появления
+    void linkLost();
+    /// адаптер снова подключён, порт переоткрыт, опрос возобновлён
+    void linkRestored();
 
 protected:
-    bool wait(int timeout = 3000);
+    using clock = std::chrono::steady_clock;
+
+    /// Захват прибора на время транзакции (рекурсивный); запоминает момент запроса
+    /// для объединения одинаковых чтений
+    class BusLock {
+        Device* const pDevice;
+
+    public:
+        explicit BusLock(Device* device)
+            : pDevice { device } {
+            const auto requested = clock::now();
+            pDevice->busMutex_.lock();
+            pDevice->requestTime_ = requested;
+            if (pDevice->linkRestoredPending_.exchange(false)) {
+                pDevice->connected_ = true; // возобновление опроса, в том числе плановых задач Scheduler
+                pDevice->linkStats_.consecutiveFailures = 0;
+            }
+        }
+        ~BusLock() { pDevice->busMutex_.unlock(); }
+    };
+
+    /// Отправка сформированной посылки и ожидание ответа. Запросы чтения, совпадающие с уже
+    /// выполненным за время ожидания (или в пределах coalesceWindow), получают его ответ.
+    /// Сохранённые ответы сбрасываются перед каждой записью и при смене состояния порта.
+    bool exchange(int timeout = 3000, bool split = true, const CancelToken* cancel = nullptr);
+    bool wait(int timeout = 3000, bool split = true);
+    /// ожидание ответа (или подтверждения открытия/закрытия) порта частями по CancelSlice
+    /// с проверкой отмены
+    bool acquireReply(int timeout);
+    /// проверка связи на текущей скорости порта
+    bool verifyLink(int attempts = 2);
+    /// Сброс сохранённых ответов (смена скорости, переподключение, потеря связи, ping).
+    /// Вызывается из любого потока; кэш очищается следующей транзакцией под BusLock.
+    void invalidateReplies() { cacheStale_ = true; }
+    /// возврат прибора, оставшегося на скорости from, на скорость to
+    bool restoreBaudRate(Baud from, Baud to);
+    /// отказ транзакции при действующем BaudBoost - возврат на исходную скорость
+    void dropBoost();
+    /// Запрос ReadData и пакетный разбор ответа в values/status (по числу каналов прибора);
+    /// возвращает число достоверных каналов или -1 при отсутствии ответа
+    int exchangeData(std::span<float> values, std::span<SampleStatus> status);
+    /// Декодирование поля данных ответа (ReadNByte, FileCmd::Read) из НЕХ формата в dst;
+    /// возвращает число байт (0 - пустое поле) или -1 при коде ошибки прибора "$nn",
+    /// неверном НЕХ или данных длиннее size
+    int takeHexData(char* dst, int size) const;
 
     Port* port_;
     QByteArray rcData_;
@@ -193,46 +440,85 @@ protected:
 
     uint8_t m_address {};
 
+    History* history_ {};
+    ShmPublisher* publisher_ {};
+    uint32_t publisherSlot_ {};
+    Store* store_ {};
+    uint32_t storeDevice_ {};
+
+    RetryPolicy retryPolicy_[2] {
+        { .attempts = 3, .backoff = 20, .maxBackoff = 200 }, // CmdClass::Read
+        { .attempts = 1, .backoff = 20, .maxBackoff = 200 }, // CmdClass::Write
+    };
+    LinkStats linkStats_;
+    int offlineThreshold_ = 3;
+    bool countFailure_ = true; ///< отказ текущей транзакции учитывается в consecutiveFailures
+    CancelToken cancelToken_;
+    std::atomic<const CancelToken*> operationCancel_ {}; ///< признак отмены текущей операции (CancelScope)
+    std::atomic<bool> aborted_ {};
+
+    struct CachedReply {
+        QByteArray reply;
+        clock::time_point received;
+    };
+    QRecursiveMutex busMutex_;
+    clock::time_point requestTime_;
+    std::chrono::milliseconds coalesceWindow_ {};
+    QHash<QByteArray, CachedReply> replyCache_;
+    std::atomic<bool> cacheStale_ {};
+    std::atomic<bool> linkRestoredPending_ {}; ///< адаптер переподключён; применяется в BusLock
+    BaudBoost* boost_ {}; ///< действующее повышение скорости (под BusLock)
+
 private:
     Parcel parcel;
+    CmdClass parcelClass_ {};
+};
 
-    static constexpr uint8_t tableCrc16Lo[] {
-        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-        0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-        0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-        0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-        0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-        0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-        0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40,
-        0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-        0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40, 0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41,
-        0x00, 0xC1, 0x81, 0x40, 0x01, 0xC0, 0x80, 0x41, 0x01, 0xC0, 0x80, 0x41, 0x00, 0xC1, 0x81, 0x40
-    };
+/// RAII: на время длительной операции (передача файла, чтение всех параметров) переводит обмен
+/// на наибольшую устойчивую скорость и восстанавливает исходную по завершении
+class BaudBoost {
+    friend class Device;
+    Device* const pDevice;
+    std::unique_lock<QRecursiveMutex> lock; ///< линия занята от повышения скорости до возврата
+    const Baud configured;
+    Baud active;
 
-    static constexpr uint8_t tableCrc16Hi[] {
-        0x00, 0xC0, 0xC1, 0x01, 0xC3, 0x03, 0x02, 0xC2, 0xC6, 0x06, 0x07, 0xC7, 0x05, 0xC5, 0xC4, 0x04,
-        0xCC, 0x0C, 0x0D, 0xCD, 0x0F, 0xCF, 0xCE, 0x0E, 0x0A, 0xCA, 0xCB, 0x0B, 0xC9, 0x09, 0x08, 0xC8,
-        0xD8, 0x18, 0x19, 0xD9, 0x1B, 0xDB, 0xDA, 0x1A, 0x1E, 0xDE, 0xDF, 0x1F, 0xDD, 0x1D, 0x1C, 0xDC,
-        0x14, 0xD4, 0xD5, 0x15, 0xD7, 0x17, 0x16, 0xD6, 0xD2, 0x12, 0x13, 0xD3, 0x11, 0xD1, 0xD0, 0x10,
-        0xF0, 0x30, 0x31, 0xF1, 0x33, 0xF3, 0xF2, 0x32, 0x36, 0xF6, 0xF7, 0x37, 0xF5, 0x35, 0x34, 0xF4,
-        0x3C, 0xFC, 0xFD, 0x3D, 0xFF, 0x3F, 0x3E, 0xFE, 0xFA, 0x3A, 0x3B, 0xFB, 0x39, 0xF9, 0xF8, 0x38,
-        0x28, 0xE8, 0xE9, 0x29, 0xEB, 0x2B, 0x2A, 0xEA, 0xEE, 0x2E, 0x2F, 0xEF, 0x2D, 0xED, 0xEC, 0x2C,
-        0xE4, 0x24, 0x25, 0xE5, 0x27, 0xE7, 0xE6, 0x26, 0x22, 0xE2, 0xE3, 0x23, 0xE1, 0x21, 0x20, 0xE0,
-        0xA0, 0x60, 0x61, 0xA1, 0x63, 0xA3, 0xA2, 0x62, 0x66, 0xA6, 0xA7, 0x67, 0xA5, 0x65, 0x64, 0xA4,
-        0x6C, 0xAC, 0xAD, 0x6D, 0xAF, 0x6F, 0x6E, 0xAE, 0xAA, 0x6A, 0x6B, 0xAB, 0x69, 0xA9, 0xA8, 0x68,
-        0x78, 0xB8, 0xB9, 0x79, 0xBB, 0x7B, 0x7A, 0xBA, 0xBE, 0x7E, 0x7F, 0xBF, 0x7D, 0xBD, 0xBC, 0x7C,
-        0xB4, 0x74, 0x75, 0xB5, 0x77, 0xB7, 0xB6, 0x76, 0x72, 0xB2, 0xB3, 0x73, 0xB1, 0x71, 0x70, 0xB0,
-        0x50, 0x90, 0x91, 0x51, 0x93, 0x53, 0x52, 0x92, 0x96, 0x56, 0x57, 0x97, 0x55, 0x95, 0x94, 0x54,
-        0x9C, 0x5C, 0x5D, 0x9D, 0x5F, 0x9F, 0x9E, 0x5E, 0x5A, 0x9A, 0x9B, 0x5B, 0x99, 0x59, 0x58, 0x98,
-        0x88, 0x48, 0x49, 0x89, 0x4B, 0x8B, 0x8A, 0x4A, 0x4E, 0x8E, 0x8F, 0x4F, 0x8D, 0x4D, 0x4C, 0x8C,
-        0x44, 0x84, 0x85, 0x45, 0x87, 0x47, 0x46, 0x86, 0x82, 0x42, 0x43, 0x83, 0x41, 0x81, 0x80, 0x40
-    };
+public:
+    explicit BaudBoost(Device* device, Baud maxBaud = Baud19200);
+    ~BaudBoost();
+    Baud baudRate() const { return active; }
+};
+
+/// Прибор конкретного типа с характеристиками, известными на этапе компиляции
+template <DeviceType Tip>
+class TypedDevice : public Device {
+public:
+    using Traits = DeviceTraits<Tip>;
+    using Values = std::array<float, Traits::Channels>;
+    using Statuses = std::array<SampleStatus, Traits::Channels>;
+
+    using Device::Device;
+    using Device::readData;
+
+    DeviceType type() const override { return Tip; }
+
+    /// Чтение всех каналов в буферы фиксированного размера без выделения памяти;
+    /// история, разделяемая память и архив не пополняются (для них - readData(Samples&))
+    bool readData(Values& values, Statuses& status) {
+        return exchangeData(values, status) == static_cast<int>(Traits::Channels);
+    }
+};
+
+/// Прибор, тип которого задаётся при создании (конфигурация, шлюз)
+class DynamicDevice : public Device {
+    const DeviceType type_;
+
+public:
+    explicit DynamicDevice(DeviceType type, QObject* parent = nullptr, DTR dtr = DTR::Off, DTS dts = DTS::Off)
+        : Device(parent, dtr, dts)
+        , type_ { type } { }
+
+    DeviceType type() const override { return type_; }
 };
 
 } // namespace Elemer
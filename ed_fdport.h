@@ -0,0 +1,175 @@
+#pragma once
+
+// Транспорт протокола ЭЛЕМЕР поверх файлового дескриптора Linux (termios) без Qt.
+// Дескриптор неблокирующий и может регистрироваться во внешнем epoll (fd(), onReadable()).
+
+#include "ed_core.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <string_view>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace Elemer {
+
+class FdPort {
+public:
+    FdPort() = default;
+    explicit FdPort(const char* path, int baud = 9600) { open(path, baud); }
+    ~FdPort() { close(); }
+
+    FdPort(const FdPort&) = delete;
+    FdPort& operator=(const FdPort&) = delete;
+
+    bool open(const char* path, int baud = 9600) noexcept {
+        close();
+        fd_ = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+        if (fd_ < 0)
+            return false;
+        if (!setBaudRate(baud)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() noexcept {
+        if (fd_ >= 0)
+            ::close(fd_);
+        fd_ = -1;
+        rxSize_ = consumed_ = 0;
+    }
+
+    bool isOpen() const noexcept { return fd_ >= 0; }
+    int fd() const noexcept { return fd_; }
+
+    /// 8N1, без управления потоком
+    bool setBaudRate(int baud) noexcept {
+        termios tio {};
+        if (tcgetattr(fd_, &tio))
+            return false;
+        cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tio.c_cflag &= ~(CSTOPB | PARENB | CRTSCTS);
+        tio.c_cc[VMIN] = 0;
+        tio.c_cc[VTIME] = 0;
+        const speed_t speed = toSpeed(baud);
+        return speed != B0 && !cfsetispeed(&tio, speed) && !cfsetospeed(&tio, speed) && !tcsetattr(fd_, TCSANOW, &tio);
+    }
+
+    bool setLines(bool dtr, bool rts) noexcept {
+        int status {};
+        if (ioctl(fd_, TIOCMGET, &status))
+            return false;
+        status = dtr ? status | TIOCM_DTR : status & ~TIOCM_DTR;
+        status = rts ? status | TIOCM_RTS : status & ~TIOCM_RTS;
+        return !ioctl(fd_, TIOCMSET, &status);
+    }
+
+    /// сброс входного буфера драйвера и принятых байт
+    void flushInput() noexcept {
+        tcflush(fd_, TCIFLUSH);
+        rxSize_ = consumed_ = 0;
+    }
+
+    bool write(std::string_view data) noexcept {
+        while (!data.empty()) {
+            const ssize_t n = ::write(fd_, data.data(), data.size());
+            if (n < 0) {
+                if (errno != EAGAIN && errno != EINTR)
+                    return false;
+                pollfd pfd { fd_, POLLOUT, 0 };
+                ::poll(&pfd, 1, 100);
+                continue;
+            }
+            data.remove_prefix(n);
+        }
+        return true;
+    }
+
+    /// Дочитывание доступных байт без ожидания (для epoll). Возвращает кадр до '\r'
+    /// включительно, когда он собран, иначе пустую строку. Кадр действителен до следующего вызова.
+    std::string_view onReadable() noexcept {
+        if (consumed_) { // удаление выданного ранее кадра
+            std::memmove(rx_.data(), rx_.data() + consumed_, rxSize_ - consumed_);
+            rxSize_ -= consumed_;
+            consumed_ = 0;
+        }
+        if (auto frame = takeFrame(); !frame.empty())
+            return frame;
+        for (;;) {
+            if (rxSize_ == rx_.size()) // переполнение - мусор на линии
+                rxSize_ = 0;
+            const ssize_t n = ::read(fd_, rx_.data() + rxSize_, rx_.size() - rxSize_);
+            if (n <= 0)
+                return {};
+            rxSize_ += n;
+            if (auto frame = takeFrame(); !frame.empty())
+                return frame;
+        }
+    }
+
+    /// ожидание кадра не дольше timeout
+    std::string_view readFrame(std::chrono::milliseconds timeout) noexcept {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        for (;;) {
+            if (auto frame = onReadable(); !frame.empty())
+                return frame;
+            const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0)
+                return {};
+            pollfd pfd { fd_, POLLIN, 0 };
+            if (::poll(&pfd, 1, static_cast<int>(left.count())) < 0 && errno != EINTR)
+                return {};
+        }
+    }
+
+    /// Транзакция: отправка посылки и приём ответа с проверкой CRC.
+    /// Возвращает кадр "!адрес;...;CRC" или пустую строку.
+    std::string_view transact(const Core::FrameBuilder& request, std::chrono::milliseconds timeout) noexcept {
+        if (!request.ok())
+            return {};
+        flushInput();
+        if (!write(request.view()))
+            return {};
+        return Core::checkFrame(readFrame(timeout));
+    }
+
+private:
+    std::string_view takeFrame() noexcept {
+        auto* end = static_cast<char*>(std::memchr(rx_.data(), '\r', rxSize_));
+        if (!end)
+            return {};
+        consumed_ = end - rx_.data() + 1;
+        return { rx_.data(), consumed_ };
+    }
+
+    static speed_t toSpeed(int baud) noexcept {
+        switch (baud) {
+        case 300: return B300;
+        case 600: return B600;
+        case 1200: return B1200;
+        case 2400: return B2400;
+        case 4800: return B4800;
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        default: return B0;
+        }
+    }
+
+    int fd_ = -1;
+    std::array<char, 512> rx_ {};
+    size_t rxSize_ {};
+    size_t consumed_ {};
+};
+
+} // namespace Elemer
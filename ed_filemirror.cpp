@@ -0,0 +1,154 @@
+#include "ed_filemirror.h"
+#include "ed_core.h"
+#include "ed_device.h"
+#include "ed_filesession.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Elemer {
+
+namespace {
+
+/// промежуток между изменениями, который выгоднее переписать, чем отправлять отдельный Seek
+constexpr qint64 MergeGap = 16;
+
+} // namespace
+
+FileMirror::FileMirror(Device* device, const QString& imagePath, int blockSize)
+    : device_ { device }
+    , blockSize_ { std::max(blockSize, 16) }
+    , file_ { imagePath } {
+}
+
+FileMirror::~FileMirror() { close(); }
+
+bool FileMirror::open(qint64 size) {
+    close();
+    if (!file_.open(QIODevice::ReadWrite))
+        return false;
+    return remap(size);
+}
+
+void FileMirror::close() {
+    if (map_)
+        file_.unmap(map_), map_ = nullptr;
+    if (file_.isOpen())
+        file_.close();
+    size_ = 0;
+    crc_.clear();
+}
+
+bool FileMirror::remap(qint64 size) {
+    if (map_)
+        file_.unmap(map_), map_ = nullptr;
+    if (file_.size() != size && !file_.resize(size))
+        return false;
+    size_ = size;
+    map_ = size ? file_.map(0, size) : nullptr;
+    if (size && !map_)
+        return false;
+    crc_.resize(blocks());
+    for (int block {}; block < blocks(); ++block)
+        crc_[block] = Core::crc16({ data() + qint64(block) * blockSize_, static_cast<size_t>(blockLength(block)) });
+    return true;
+}
+
+bool FileMirror::pull() {
+    FileSession session(device_);
+    if (!map_ || !session.open())
+        return false;
+    const bool success = session.read(map_, size_);
+    session.close();
+    remap(size_); // пересчёт CRC блоков
+    return success;
+}
+
+bool FileMirror::push(const QByteArray& newContent, SyncStats* stats) {
+    SyncStats st;
+    // в протоколе нет усечения файла: более короткое содержимое дополняется нулями до прежнего
+    // размера, чтобы в приборе не остался хвост старых данных, а образ совпадал с файлом
+    const QByteArray content = newContent.size() < size_
+        ? newContent.leftJustified(static_cast<int>(size_), '\0')
+        : newContent;
+    const qint64 oldSize = size_;
+    if (content.size() != size_ && !remap(content.size()))
+        return false;
+
+    FileSession session(device_);
+    if (!session.open()) {
+        remap(oldSize);
+        return false;
+    }
+
+    const char* const src = content.constData();
+    char* const image = reinterpret_cast<char*>(map_);
+    QByteArray readback(blockSize_, Qt::Uninitialized);
+    bool success = true;
+
+    for (int block {}; block < blocks() && success; ++block) {
+        const qint64 begin = qint64(block) * blockSize_;
+        const qint64 length = blockLength(block);
+        const uint16_t crc = Core::crc16({ src + begin, static_cast<size_t>(length) });
+        const bool grown = begin + length > oldSize;
+        if (crc == crc_[block] && !grown && !std::memcmp(src + begin, image + begin, length))
+            continue;
+        ++st.blocksChanged;
+
+        // запись изменённых диапазонов блока; близкие диапазоны объединяются
+        for (qint64 pos = begin, end = begin + length; pos < end;) {
+            while (pos < end && pos < oldSize && src[pos] == image[pos])
+                ++pos;
+            if (pos == end)
+                break;
+            qint64 last = pos, gap {};
+            for (qint64 i = pos; i < end && gap <= MergeGap; ++i) {
+                if (i >= oldSize || src[i] != image[i])
+                    last = i, gap = 0;
+                else
+                    ++gap;
+            }
+            if (!session.seek(pos) || !session.write(src + pos, last - pos + 1)) {
+                success = false;
+                break;
+            }
+            ++st.rangesWritten;
+            st.bytesWritten += last - pos + 1;
+            pos = last + 1;
+        }
+
+        // проверка блока чтением; при расхождении блок переписывается целиком один раз
+        for (int attempt {}; success; ++attempt) {
+            if (!session.seek(begin) || !session.read(readback.data(), length)) {
+                success = false;
+                break;
+            }
+            if (Core::crc16({ readback.constData(), static_cast<size_t>(length) }) == crc)
+                break;
+            ++st.verifyFailures;
+            if (attempt || !session.seek(begin) || !session.write(src + begin, length)) {
+                success = false;
+                break;
+            }
+            st.bytesWritten += length;
+        }
+        if (!success)
+            break;
+
+        std::memcpy(image + begin, src + begin, length);
+        crc_[block] = crc;
+    }
+
+    success &= session.close();
+    // при сбое образ возвращается к прежнему размеру: файл в приборе мог не вырасти, а хвост
+    // образа не должен служить эталоном для следующего сравнения; CRC пересчитываются по образу,
+    // в котором обновлены только проверенные блоки
+    if (!success && size_ != oldSize)
+        remap(oldSize);
+    file_.flush();
+    if (stats)
+        *stats = st;
+    return success;
+}
+
+} // namespace Elemer
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace Elemer {
+
+class Device;
+
+/// Локальный образ файла прибора в отображаемом в память файле с контрольной суммой
+/// каждого блока. При загрузке нового содержимого в прибор записываются только изменённые
+/// диапазоны байт, после чего каждый затронутый блок проверяется чтением и сверкой CRC.
+class FileMirror {
+public:
+    struct SyncStats {
+        int blocksChanged {};
+        int rangesWritten {};
+        qint64 bytesWritten {};
+        int verifyFailures {};
+    };
+
+    FileMirror(Device* device, const QString& imagePath, int blockSize = 256);
+    ~FileMirror();
+
+    FileMirror(const FileMirror&) = delete;
+    FileMirror& operator=(const FileMirror&) = delete;
+
+    /// открытие (создание) образа; size - размер файла прибора
+    bool open(qint64 size);
+    void close();
+
+    /// полное чтение файла прибора в образ (первичная синхронизация)
+    bool pull();
+
+    /// Загрузка нового содержимого в прибор с записью только отличающихся байт. Файл прибора
+    /// не укорачивается: содержимое короче текущего размера дополняется нулевыми байтами.
+    bool push(const QByteArray& newContent, SyncStats* stats = nullptr);
+
+    qint64 size() const { return size_; }
+    const char* data() const { return reinterpret_cast<const char*>(map_); }
+    uint16_t blockCrc(int block) const { return crc_[block]; }
+
+private:
+    bool remap(qint64 size);
+    int blocks() const { return static_cast<int>((size_ + blockSize_ - 1) / blockSize_); }
+    qint64 blockLength(int block) const { return std::min<qint64>(blockSize_, size_ - qint64(block) * blockSize_); }
+
+    Device* const device_;
+    const int blockSize_;
+    QFile file_;
+    uchar* map_ {};
+    qint64 size_ {};
+    std::vector<uint16_t> crc_;
+};
+
+} // namespace Elemer
@@ -0,0 +1,127 @@
+#include "ed_filesession.h"
+#include "ed_device.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace Elemer {
+
+FileSession::FileSession(Device* device, int blockSize, const CancelToken* cancel)
+    : device_ { device }
+    , cancel_ { cancel }
+    , blockSize_ { blockSize > 0 ? std::min(blockSize, Device::MaxFileChunk) : Device::MaxFileChunk } {
+    readBuf_.reserve(blockSize_);
+    writeBuf_.reserve(blockSize_ * 2);
+}
+
+FileSession::~FileSession() { flush(); }
+
+bool FileSession::open() {
+    readBuf_.clear();
+    writeBuf_.clear();
+    pos_ = 0;
+    Device::CancelScope scope(device_, cancel_);
+    devicePos_ = device_->fileOpen() ? 0 : -1;
+    return devicePos_ == 0;
+}
+
+bool FileSession::close() {
+    const bool flushed = flush();
+    readBuf_.clear();
+    devicePos_ = -1;
+    Device::CancelScope scope(device_, cancel_);
+    return device_->fileClose() && flushed;
+}
+
+bool FileSession::seek(qint64 pos) {
+    if (pos < 0 || pos > std::numeric_limits<uint16_t>::max())
+        return false;
+    // несмежная запись не может быть объединена с накопленной
+    if (!writeBuf_.isEmpty() && pos != writeBase_ + writeBuf_.size() && !flush())
+        return false;
+    pos_ = pos;
+    return true;
+}
+
+bool FileSession::syncPosition(qint64 pos) {
+    if (devicePos_ == pos)
+        return true;
+    Device::CancelScope scope(device_, cancel_);
+    if (!device_->fileSeek(static_cast<uint16_t>(pos), Seek::Set)) {
+        devicePos_ = -1;
+        return false;
+    }
+    devicePos_ = pos;
+    return true;
+}
+
+bool FileSession::read(void* dst, qint64 size) {
+    if (!writeBuf_.isEmpty() && !flush())
+        return false;
+    auto* out = static_cast<char*>(dst);
+    while (size > 0) {
+        const qint64 offset = pos_ - readBase_;
+        if (offset >= 0 && offset < readBuf_.size()) {
+            const qint64 count = std::min<qint64>(size, readBuf_.size() - offset);
+            std::memcpy(out, readBuf_.constData() + offset, count);
+            out += count, pos_ += count, size -= count;
+            continue;
+        }
+        // упреждающее чтение блока
+        if (!syncPosition(pos_))
+            return false;
+        readBuf_.resize(blockSize_);
+        const int count = device_->fileReadBytes(readBuf_.data(), blockSize_, cancel_);
+        if (count <= 0) { // ошибка или конец файла
+            readBuf_.clear();
+            devicePos_ = -1;
+            return false;
+        }
+        readBuf_.resize(count);
+        readBase_ = pos_;
+        devicePos_ = pos_ + count;
+    }
+    return true;
+}
+
+bool FileSession::write(const void* src, qint64 size) {
+    if (!writeBuf_.isEmpty() && pos_ != writeBase_ + writeBuf_.size() && !flush())
+        return false;
+    if (writeBuf_.isEmpty())
+        writeBase_ = pos_;
+    writeBuf_.append(static_cast<const char*>(src), static_cast<int>(size));
+    pos_ += size;
+
+    // перекрытый записью упреждающий блок устарел
+    if (readBase_ < pos_ && writeBase_ < readBase_ + readBuf_.size())
+        readBuf_.clear();
+
+    // полные блоки отправляются сразу, остаток ждёт flush()
+    while (writeBuf_.size() >= blockSize_) {
+        if (!syncPosition(writeBase_) || !device_->fileWriteBytes(writeBuf_.constData(), blockSize_, cancel_)) {
+            devicePos_ = -1;
+            return false;
+        }
+        writeBase_ += blockSize_;
+        devicePos_ = writeBase_;
+        writeBuf_.remove(0, blockSize_);
+    }
+    return true;
+}
+
+bool FileSession::flush() {
+    while (!writeBuf_.isEmpty()) {
+        const int count = std::min<int>(writeBuf_.size(), blockSize_);
+        if (!syncPosition(writeBase_) || !device_->fileWriteBytes(writeBuf_.constData(), count, cancel_)) {
+            devicePos_ = -1;
+            return false;
+        }
+        writeBase_ += count;
+        devicePos_ = writeBase_;
+        writeBuf_.remove(0, count);
+    }
+    return true;
+}
+
+} // namespace Elemer
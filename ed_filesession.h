@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QByteArray>
+#include <cstdint>
+#include <type_traits>
+
+namespace Elemer {
+
+class CancelToken;
+class Device;
+
+/// Буферизованная работа с файлом прибора: последовательные мелкие чтения обслуживаются
+/// из блока упреждающего чтения максимального размера, мелкие записи объединяются в полные
+/// посылки FileCmd::Write при заполнении блока, flush() или seek(). Позиция в файле
+/// отслеживается локально, FileCmd::Seek отправляется только при её расхождении с прибором.
+/// Передачу можно прервать токеном cancel, не останавливая остальной опрос прибора.
+class FileSession {
+public:
+    explicit FileSession(Device* device, int blockSize = 0, const CancelToken* cancel = nullptr);
+    ~FileSession();
+
+    FileSession(const FileSession&) = delete;
+    FileSession& operator=(const FileSession&) = delete;
+
+    bool open();
+    bool close();
+
+    /// позиция от начала файла; запрос к прибору откладывается до следующей операции
+    bool seek(qint64 pos);
+    qint64 pos() const { return pos_; }
+
+    bool read(void* dst, qint64 size);
+    bool write(const void* src, qint64 size);
+    bool flush();
+
+    /// Чтение значений подряд (аналог Device::fileRead); отдельное имя, чтобы вызов
+    /// read(массив, размер) не попадал в эту перегрузку
+    template <typename... Ts>
+    bool readValues(Ts&... vals) requires(!std::is_pointer_v<Ts> && ...) {
+        return (read(static_cast<void*>(&vals), sizeof(Ts)) && ...);
+    }
+
+    /// Запись значений подряд (аналог Device::fileWrite)
+    template <typename... Ts>
+    bool writeValues(const Ts&... vals) requires(!std::is_pointer_v<Ts> && ...) {
+        return (write(static_cast<const void*>(&vals), sizeof(Ts)) && ...);
+    }
+
+private:
+    bool syncPosition(qint64 pos);
+
+    Device* const device_;
+    const CancelToken* const cancel_;
+    const int blockSize_;
+    qint64 pos_ {};
+    qint64 devicePos_ = -1; ///< позиция в приборе, -1 - неизвестна
+
+    QByteArray readBuf_;
+    qint64 readBase_ {};
+
+    QByteArray writeBuf_;
+    qint64 writeBase_ {};
+};
+
+} // namespace Elemer
@@ -0,0 +1,214 @@
+#pragma once
+
+#include "ed_samples.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace Elemer {
+
+/// Кольцевой буфер фиксированной ёмкости: один писатель, любое число читателей, без блокировок.
+/// Каждая ячейка защищена собственным счётчиком (seqlock), читатель повторяет чтение, если
+/// ячейка была перезаписана во время копирования.
+template <typename T>
+class RingBuffer {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    static constexpr int ReadRetries = 1000; ///< предел попыток чтения ячейки, изменяемой писателем
+
+    struct Slot {
+        std::atomic<uint64_t> seq {};
+        T value {};
+    };
+
+public:
+    explicit RingBuffer(size_t capacity)
+        : capacity_ { std::bit_ceil(std::max<size_t>(capacity, 2)) }
+        , mask_ { capacity_ - 1 }
+        , slots_ { std::make_unique<Slot[]>(capacity_) } { }
+
+    size_t capacity() const noexcept { return capacity_; }
+
+    /// абсолютный индекс следующей записи (общее число записанных элементов)
+    uint64_t head() const noexcept { return head_.load(std::memory_order_acquire); }
+
+    /// только для потока-писателя
+    void push(const T& value) noexcept {
+        const uint64_t index = head_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[index & mask_];
+        const uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+        slot.seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.value = value;
+        slot.seq.store(seq + 2, std::memory_order_release);
+        head_.store(index + 1, std::memory_order_release);
+    }
+
+    /// чтение элемента по абсолютному индексу; false, если он уже перезаписан, ещё не записан
+    /// или писатель не завершил запись за ReadRetries попыток
+    bool at(uint64_t index, T& out) const noexcept {
+        const Slot& slot = slots_[index & mask_];
+        const uint64_t expected = (index / capacity_ + 1) * 2;
+        for (int retry {}; retry < ReadRetries; ++retry) {
+            const uint64_t seq1 = slot.seq.load(std::memory_order_acquire);
+            if (seq1 & 1)
+                continue; // идёт запись
+            if (seq1 != expected)
+                return false;
+            out = slot.value;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) == seq1)
+                return true;
+        }
+        return false;
+    }
+
+    /// копирование последних out.size() элементов в хронологическом порядке, возвращает их число
+    size_t copyLast(std::span<T> out) const noexcept {
+        const uint64_t end = head();
+        const uint64_t count = std::min<uint64_t>({ out.size(), end, capacity_ });
+        size_t copied {};
+        for (uint64_t index = end - count; index < end; ++index)
+            if (at(index, out[copied]))
+                ++copied;
+        return copied;
+    }
+
+private:
+    const size_t capacity_;
+    const size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+    alignas(64) std::atomic<uint64_t> head_ {};
+};
+
+/// отсчёт канала
+struct Point {
+    int64_t time; ///< нс от эпохи system_clock
+    float value;
+};
+
+/// агрегат отсчётов канала за интервал
+struct Aggregate {
+    int64_t begin; ///< начало интервала, нс
+    float min;
+    float max;
+    float mean;
+    float last; ///< прореженное значение - последний отсчёт интервала
+    uint32_t count;
+};
+
+struct HistoryConfig {
+    struct Tier {
+        int64_t interval; ///< длительность интервала агрегации, нс
+        size_t capacity;  ///< число хранимых агрегатов
+    };
+    size_t rawCapacity = 4096;
+    std::vector<Tier> tiers {
+        { 1'000'000'000LL, 3600 },   // 1 с, час
+        { 60'000'000'000LL, 1440 },  // 1 мин, сутки
+        { 600'000'000'000LL, 1008 }, // 10 мин, неделя
+    };
+};
+
+/// История одного канала: сырые отсчёты и уровни агрегатов, пополняемые на лету
+class ChannelHistory {
+public:
+    class Tier {
+        friend class ChannelHistory;
+
+    public:
+        Tier(int64_t interval, size_t capacity)
+            : interval_ { interval }
+            , ring_ { capacity } { }
+
+        int64_t interval() const noexcept { return interval_; }
+        const RingBuffer<Aggregate>& aggregates() const noexcept { return ring_; }
+
+    private:
+        void append(const Point& p) noexcept {
+            const int64_t begin = p.time - p.time % interval_;
+            if (acc_.count && begin != acc_.begin)
+                commit();
+            if (!acc_.count) {
+                acc_ = { .begin = begin, .min = p.value, .max = p.value, .mean = {}, .last = p.value, .count = 0 };
+                sum_ = {};
+            }
+            acc_.min = std::min(acc_.min, p.value);
+            acc_.max = std::max(acc_.max, p.value);
+            acc_.last = p.value;
+            sum_ += p.value;
+            ++acc_.count;
+        }
+        void commit() noexcept {
+            acc_.mean = static_cast<float>(sum_ / acc_.count);
+            ring_.push(acc_);
+            acc_.count = 0;
+        }
+
+        const int64_t interval_;
+        RingBuffer<Aggregate> ring_;
+        Aggregate acc_ {};
+        double sum_ {};
+    };
+
+    explicit ChannelHistory(const HistoryConfig& config = {})
+        : raw_ { config.rawCapacity } {
+        for (auto&& [interval, capacity] : config.tiers)
+            tiers_.emplace_back(interval, capacity);
+    }
+
+    /// только для потока-писателя
+    void append(const Point& p) noexcept {
+        raw_.push(p);
+        for (auto& tier : tiers_)
+            tier.append(p);
+    }
+
+    const RingBuffer<Point>& raw() const noexcept { return raw_; }
+    const std::deque<Tier>& tiers() const noexcept { return tiers_; }
+
+    /// самый грубый уровень, интервал которого не превышает требуемого разрешения (нс)
+    const Tier* tierFor(int64_t resolution) const noexcept {
+        const Tier* best {};
+        for (auto& tier : tiers_)
+            if (tier.interval() <= resolution && (!best || tier.interval() > best->interval()))
+                best = &tier;
+        return best;
+    }
+
+private:
+    RingBuffer<Point> raw_;
+    std::deque<Tier> tiers_;
+};
+
+/// История всех каналов прибора
+class History {
+public:
+    explicit History(size_t channels, const HistoryConfig& config = {}) {
+        for (size_t ch {}; ch < channels; ++ch)
+            channels_.emplace_back(config);
+    }
+
+    /// добавление результатов опроса; каналы без достоверного значения пропускаются
+    void append(const Samples& samples) noexcept {
+        const size_t count = std::min(samples.channels(), channels_.size());
+        for (size_t ch {}; ch < count; ++ch)
+            if (samples.status[ch] == SampleStatus::Ok)
+                channels_[ch].append({ samples.timestamp, samples.values[ch] });
+    }
+
+    size_t channels() const noexcept { return channels_.size(); }
+    const ChannelHistory& operator[](size_t ch) const noexcept { return channels_[ch]; }
+
+private:
+    std::deque<ChannelHistory> channels_;
+};
+
+} // namespace Elemer
@@ -2,8 +2,18 @@
 #include "ed_device.h"
 #include "ed_utils.h"
 
+#include <QDir>
+#include <QFileInfo>
+#include <QSerialPortInfo>
+#include <QThread>
+#include <algorithm>
 #include <qcoreevent.h>
 #include <ratio>
+#include <utility>
+
+#ifdef Q_OS_UNIX
+#include <termios.h>
+#endif
 
 namespace Elemer {
 
@@ -15,9 +25,7 @@ Port::Port(Device* asciiDevice)
     setFlowControl(NoFlowControl);
     connect(this, &QSerialPort::readyRead, this, &Port::Read);
 
-    connect(this, &QSerialPort::errorOccurred, [](QSerialPort::SerialPortError error) {
-        qWarning() << "SerialPortError" << error;
-    });
+    connect(this, &QSerialPort::errorOccurred, this, &Port::onError);
 }
 
 Port::~Port() {
@@ -28,8 +36,17 @@ Port::~Port() {
 }
 
 void Port::Open(int mode) {
-    if (!open(static_cast<OpenMode>(mode)))
+    wantOpen_ = true;
+    if (!open(static_cast<OpenMode>(mode))) {
         emit message(portName() + ": " + errorString());
+    } else {
+        if (halfDuplex_)
+            setRequestToSend(false); // приём
+        stablePath_ = findStablePath();
+        if (replugTimerId) // переоткрыт вручную (ping) раньше, чем обнаружен адаптер
+            killTimer(replugTimerId), replugTimerId = 0;
+        unplugged_ = false;
+    }
     device->semaphore_.release();
 
 #ifdef FORCE_READ
@@ -39,6 +56,7 @@ void Port::Open(int mode) {
 }
 
 void Port::Close() {
+    wantOpen_ = false;
     close();
     device->semaphore_.release();
 #ifdef FORCE_READ
@@ -50,6 +68,13 @@ void Port::Close() {
 void Port::Write(const Parcel& data) {
 //    if (!isOpen())
 //        return;
+    if (halfDuplex_) {
+        if (echo_) {
+            QMutexLocker locker(&m_mutex);
+            m_echoData = data.data;
+        }
+        setRequestToSend(true);
+    }
 #ifdef EL_LOG
     timer.start();
     write(data);
@@ -57,16 +82,135 @@ void Port::Write(const Parcel& data) {
 #else
     write(data);
 #endif
+    if (halfDuplex_) {
+        drainTx();
+        setRequestToSend(false);
+    }
+}
+
+void Port::drainTx() {
+    // передача всех байт драйверу и ожидание ухода последнего стопового бита
+    while (bytesToWrite() > 0 && waitForBytesWritten(100))
+        ;
+#ifdef Q_OS_UNIX
+    tcdrain(handle());
+#else
+    // без tcdrain - оценка по времени передачи буфера UART (16 байт по 10 бит)
+    QThread::usleep(16 * 10 * 1'000'000ULL / std::max<qint32>(baudRate(), 1));
+#endif
+}
+
+void Port::onError(QSerialPort::SerialPortError error) {
+    if (error == NoError)
+        return;
+    qWarning() << "SerialPortError" << error;
+    if (error == ResourceError && isOpen())
+        unplug();
+}
+
+void Port::unplug() {
+    if (unplugged_)
+        return;
+    unplugged_ = true;
+    emit message(portName() + ": адаптер отключён, ожидание подключения.");
+    close();
+#ifdef FORCE_READ
+    if (forceReadTimerId)
+        killTimer(forceReadTimerId), forceReadTimerId = 0;
+#endif
+    {
+        QMutexLocker locker(&m_mutex);
+        m_answerData.clear();
+        m_echoData.clear();
+    }
+    device->semaphore_.release(); // ожидающая транзакция завершается без таймаута
+    replugTimerId = startTimer(ReplugInterval);
+    emit linkLost();
+}
+
+void Port::replug() {
+    // Номер ttyUSB после переподключения может измениться, путь by-id - нет. Заданное
+    // пользователем имя сохраняется, пока оно указывает на тот же адаптер; иначе порт
+    // открывается по пути by-id, а не по текущему узлу ttyUSBn.
+    if (!stablePath_.isEmpty()) {
+        const QString node = QFileInfo(stablePath_).canonicalFilePath();
+        if (node.isEmpty())
+            return;
+        if (QFileInfo(systemLocation()).canonicalFilePath() != node)
+            setPortName(stablePath_);
+    } else if (QSerialPortInfo(portName()).isNull()) {
+        return;
+    }
+    if (wantOpen_) {
+        // скорость и формат кадра QSerialPort применяет при открытии из сохранённых настроек
+        if (!open(ReadWrite))
+            return; // узел создан, но ещё недоступен (права udev) - повтор по таймеру
+        setDataTerminalReady(device->dtr == DTR::On);
+        setRequestToSend(!halfDuplex_ && device->dts == DTS::On);
+#ifdef FORCE_READ
+        forceReadTimerId = startTimer(10ms);
+#endif
+    }
+    killTimer(replugTimerId), replugTimerId = 0;
+    device->semaphore_.acquire(device->semaphore_.available());
+    unplugged_ = false;
+    emit message(portName() + ": адаптер подключён.");
+    emit linkRestored();
+}
+
+QString Port::findStablePath() const {
+#ifdef Q_OS_LINUX
+    const QString target = QFileInfo(systemLocation()).canonicalFilePath();
+    const auto links = QDir("/dev/serial/by-id").entryInfoList(QDir::Files | QDir::System | QDir::NoDotAndDotDot);
+    for (const QFileInfo& link : links) {
+        if (link.canonicalFilePath() == target)
+            return link.absoluteFilePath();
+    }
+#endif
+    return {};
+}
+
+void Port::FlushInput() {
+    QMutexLocker locker(&m_mutex);
+    m_answerData.clear();
+    m_echoData.clear();
+    m_reply.clear();
+    clear(Input);
+    // устаревшие ответы, принятые после истечения ожидания
+    device->semaphore_.acquire(device->semaphore_.available());
+}
+
+QByteArray Port::takeReply() {
+    QMutexLocker locker(&m_mutex);
+    return std::exchange(m_reply, {});
 }
 
 void Port::Read() {
     QMutexLocker locker(&m_mutex);
     m_answerData.append(readAll());
+    // эхо собственной посылки в двухпроводной линии
+    if (!m_echoData.isEmpty()) {
+        int n {};
+        const int size = std::min(m_echoData.size(), m_answerData.size());
+        while (n < size && m_answerData[n] == m_echoData[n])
+            ++n;
+        if (n == size) { // совпадение (возможно, частичное - остаток эха придёт позже)
+            m_answerData.remove(0, n);
+            m_echoData.remove(0, n);
+        } else {
+            m_echoData.clear(); // эхо искажено, далее синхронизация по '!'
+        }
+    }
+    // синхронизация по началу кадра: всё до '!' - мусор на линии
+    if (int index = m_answerData.indexOf('!'); index < 0)
+        m_answerData.clear();
+    else if (index > 0)
+        m_answerData.remove(0, index);
     if (int index = m_answerData.indexOf('\r'); ++index > 0) {
-        device->rcData_ = m_answerData.mid(0, index);
+        m_reply = m_answerData.mid(0, index);
 #ifdef EL_LOG
         timer.stop();
-        qDebug("    Rd %s %s %s", portName().toLocal8Bit().data(), timer.stp().data(), device->rcData_.data());
+        qDebug("    Rd %s %s %s", portName().toLocal8Bit().data(), timer.stp().data(), m_reply.data());
 #endif
         m_answerData.remove(0, index);
         device->semaphore_.release();
@@ -76,6 +220,8 @@ void Port::Read() {
 void Port::timerEvent(QTimerEvent* event) {
     if (event->timerId() == forceReadTimerId)
         Read();
+    else if (event->timerId() == replugTimerId)
+        replug();
 }
 
 CloseAfterRaad::CloseAfterRaad(Device* ad)
@@ -86,7 +232,8 @@ CloseAfterRaad::CloseAfterRaad(Device* ad)
     pDevice->connected_ = pDevice->semaphore_.tryAcquire(1, 1000); // ждём открытия порта
     if (pDevice->connected_) {
         pDevice->port_->setDataTerminalReady(pDevice->dtr == DTR::On);
-        pDevice->port_->setRequestToSend(pDevice->dts == DTS::On);
+        if (!pDevice->port_->halfDuplex())
+            pDevice->port_->setRequestToSend(pDevice->dts == DTS::On);
         pDevice->portThread_.msleep(50);
     }
 }
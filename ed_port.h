@@ -2,6 +2,7 @@
 
 #include <QMutex>
 #include <QSerialPort>
+#include <atomic>
 #include <chrono>
 #include <sstream>
 #include <string_view>
@@ -65,8 +66,23 @@ class Port : public QSerialPort {
     Q_OBJECT
     friend class Device;
 
+public:
+    /// Полудуплексный режим RS-485: RTS поднимается на время передачи и снимается сразу после
+    /// ухода последнего бита; при echo собственная посылка вырезается из принятых данных
+    void setHalfDuplex(bool enabled, bool echo = true) { halfDuplex_ = enabled, echo_ = echo; }
+    bool halfDuplex() const { return halfDuplex_; }
+
+    /// Адаптер отключён (ResourceError): транзакции завершаются сразу, порт ждёт повторного
+    /// появления узла и переоткрывается сам
+    bool unplugged() const { return unplugged_; }
+
+    /// период проверки появления отключённого адаптера
+    static constexpr auto ReplugInterval = std::chrono::milliseconds(100);
+
 signals:
     void message(const QString&, int timout = {});
+    void linkLost();
+    void linkRestored();
 
 private:
     Port(Device* kds);
@@ -74,13 +90,33 @@ private:
     void Open(int mode);
     void Close();
     void Write(const Parcel& data);
+    void FlushInput();
 
     void Read();
 
+    void drainTx();
+
+    void onError(QSerialPort::SerialPortError error);
+    void unplug();
+    void replug();
+    /// постоянный путь /dev/serial/by-id текущего порта (не меняется при переподключении)
+    QString findStablePath() const;
+
+    /// последний принятый кадр; забирается транзакцией в её потоке, а не пишется в Device
+    QByteArray takeReply();
+
     QByteArray m_answerData;
+    QByteArray m_echoData;
+    QByteArray m_reply;
+    std::atomic<bool> halfDuplex_ {};
+    std::atomic<bool> echo_ {};
+    std::atomic<bool> unplugged_ {};
+    bool wantOpen_ {}; ///< порт должен быть открыт (по последней команде Open/Close)
+    QString stablePath_;
     QMutex m_mutex;
     Device* device;
     int forceReadTimerId {};
+    int replugTimerId {};
 #ifdef EL_LOG
     Timer timer;
 #endif
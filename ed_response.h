@@ -0,0 +1,127 @@
+#pragma once
+
+#include "ed_core.h"
+
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace Elemer {
+
+/// поле ответа в НЕХ формате (образ памяти значения, как формирует ToHex)
+template <typename T>
+struct Hex {
+    static_assert(std::is_trivially_copyable_v<T>);
+};
+
+/// строковое поле ответа длиной не более N символов
+template <size_t N>
+struct Str { };
+
+/// строка фиксированной ёмкости без выделения памяти
+template <size_t N>
+struct FixedString {
+    std::array<char, N> data {};
+    uint8_t length {};
+
+    constexpr std::string_view view() const noexcept { return { data.data(), length }; }
+    constexpr size_t size() const noexcept { return length; }
+    operator std::string_view() const noexcept { return view(); }
+};
+
+namespace detail {
+
+/// декодирование поля ответа в значение; тип значения определяется описанием поля
+template <typename Field>
+struct FieldCodec {
+    static_assert(std::is_arithmetic_v<Field> || std::is_enum_v<Field>, "unsupported response field");
+    using value_type = Field;
+
+    static bool decode(std::string_view str, value_type& val) noexcept { return Core::parse(str, val); }
+};
+
+template <typename T>
+struct FieldCodec<Hex<T>> {
+    using value_type = T;
+
+    static bool decode(std::string_view str, value_type& val) noexcept {
+        std::array<std::byte, sizeof(T)> bytes;
+        if (str.size() != sizeof(T) * 2 || Core::fromHex(str, bytes) != static_cast<ptrdiff_t>(sizeof(T)))
+            return false;
+        std::memcpy(&val, bytes.data(), sizeof(T));
+        return true;
+    }
+};
+
+template <size_t N>
+struct FieldCodec<Str<N>> {
+    static_assert(N < 256);
+    using value_type = FixedString<N>;
+
+    static bool decode(std::string_view str, value_type& val) noexcept {
+        if (str.size() > N)
+            return false;
+        std::memcpy(val.data.data(), str.data(), str.size());
+        val.length = static_cast<uint8_t>(str.size());
+        return true;
+    }
+};
+
+} // namespace detail
+
+/// Схема ответа прибора, известная на этапе компиляции, например
+/// Response<int, float, Hex<uint32_t>, Str<16>>. Поля декодируются из кадра
+/// "!адрес;поле1;...;полеN;CRC" за один проход слева направо без выделения памяти.
+template <typename... Fields>
+struct Response {
+    using tuple = std::tuple<typename detail::FieldCodec<Fields>::value_type...>;
+    static constexpr size_t fieldCount = sizeof...(Fields);
+
+    tuple values {};
+    uint8_t address {};
+    size_t failedField {}; ///< номер первого некорректного поля (с 1), 0 - ошибок нет
+
+    template <size_t I>
+    auto& get() noexcept { return std::get<I>(values); }
+    template <size_t I>
+    const auto& get() const noexcept { return std::get<I>(values); }
+
+    /// разбор кадра с уже проверенной контрольной суммой
+    bool decode(std::string_view frame) noexcept {
+        if (frame.starts_with('!'))
+            frame.remove_prefix(1);
+        failedField = {};
+        const char* pos = frame.data();
+        const char* const end = pos + frame.size();
+
+        auto next = [&pos, end](std::string_view& field) noexcept {
+            auto* semi = static_cast<const char*>(std::memchr(pos, ';', end - pos));
+            if (!semi)
+                return false;
+            field = { pos, static_cast<size_t>(semi - pos) };
+            pos = semi + 1;
+            return true;
+        };
+
+        std::string_view field;
+        if (!next(field) || !detail::FieldCodec<uint8_t>::decode(field, address))
+            return false;
+        return decodeFields(next, std::index_sequence_for<Fields...> {});
+    }
+
+private:
+    template <typename Next, size_t... Is>
+    bool decodeFields(Next& next, std::index_sequence<Is...>) noexcept {
+        std::string_view field;
+        return (((next(field) && detail::FieldCodec<Fields>::decode(field, std::get<Is>(values)))
+                    || (failedField = Is + 1, false))
+            && ...);
+    }
+};
+
+} // namespace Elemer
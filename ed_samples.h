@@ -0,0 +1,47 @@
+#pragma once
+
+#include "ed_core.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace Elemer {
+
+/// Буфер измерений в виде структуры массивов: значения и флаги состояния по каналам
+/// плюс метка времени опроса. Память выделяется один раз при создании, повторные опросы
+/// её не перераспределяют, поэтому values можно обрабатывать векторно целиком.
+struct Samples {
+    std::vector<float> values;
+    std::vector<SampleStatus> status;
+    int64_t timestamp {}; ///< время получения ответа, нс от эпохи system_clock
+    uint64_t sequence {}; ///< номер опроса, увеличивается при каждом заполнении
+
+    Samples() = default;
+    explicit Samples(size_t channels)
+        : values(channels)
+        , status(channels) { }
+
+    size_t channels() const noexcept { return values.size(); }
+
+    /// пометить все каналы как не полученные (без перераспределения памяти)
+    void invalidate() noexcept {
+        std::fill(values.begin(), values.end(), 0.0f);
+        std::fill(status.begin(), status.end(), SampleStatus::NoData);
+    }
+
+    void stamp() noexcept {
+        timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+                        .count();
+        ++sequence;
+    }
+
+    bool allOk() const noexcept {
+        return std::all_of(status.begin(), status.end(), [](SampleStatus s) { return s == SampleStatus::Ok; });
+    }
+};
+
+} // namespace Elemer
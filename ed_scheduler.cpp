@@ -0,0 +1,208 @@
+#include "ed_scheduler.h"
+#include "ed_device.h"
+
+#include <QDeadlineTimer>
+#include <algorithm>
+#include <utility>
+
+namespace Elemer {
+
+using namespace std::chrono;
+
+Scheduler::Scheduler(QObject* parent)
+    : QObject(parent) {
+}
+
+Scheduler::~Scheduler() { stop(); }
+
+Scheduler::Worker& Scheduler::worker(Device* device) {
+    // mutex_ уже захвачен; имя порта меняется (ping, переподключение), сам порт прибора - нет
+    auto& w = workers_[device->port()];
+    if (!w) {
+        w = std::make_shared<Worker>();
+        if (running_)
+            startWorker(*w);
+    }
+    return *w;
+}
+
+Scheduler::TaskId Scheduler::addPeriodic(Device* device, milliseconds period, Task task, Lane lane) {
+    QMutexLocker locker(&mutex_);
+    auto entry = std::make_shared<Entry>(Entry {
+        .id = ++lastId_,
+        .device = device,
+        .task = std::move(task),
+        .lane = lane,
+        .period = period,
+        .release = clock::now(),
+        .stats = {},
+    });
+    Worker& w = worker(device);
+    QMutexLocker wLocker(&w.mutex);
+    w.tasks.emplace_back(entry);
+    w.cv.wakeOne();
+    return entry->id;
+}
+
+void Scheduler::remove(TaskId id) {
+    QMutexLocker locker(&mutex_);
+    for (auto& w : workers_) {
+        QMutexLocker wLocker(&w->mutex);
+        std::erase_if(w->tasks, [id](auto& e) { return e->id == id; });
+    }
+}
+
+void Scheduler::removeAll(Device* device) {
+    QMutexLocker locker(&mutex_);
+    for (auto& w : workers_) {
+        QMutexLocker wLocker(&w->mutex);
+        std::erase_if(w->tasks, [device](auto& e) { return e->device == device; });
+        std::erase_if(w->oneShots, [device](auto& e) { return e.device == device; });
+    }
+}
+
+void Scheduler::post(Device* device, Task task, Lane lane) {
+    QMutexLocker locker(&mutex_);
+    Worker& w = worker(device);
+    QMutexLocker wLocker(&w.mutex);
+    // разовые задачи упорядочены по приоритету, внутри приоритета - по времени поступления
+    auto it = std::find_if(w.oneShots.begin(), w.oneShots.end(), [lane](auto& e) { return e.lane > lane; });
+    w.oneShots.insert(it, { device, std::move(task), lane });
+    w.cv.wakeOne();
+}
+
+TaskStats Scheduler::stats(TaskId id) const {
+    QMutexLocker locker(&mutex_);
+    for (auto& w : workers_) {
+        QMutexLocker wLocker(&w->mutex);
+        for (auto& e : w->tasks)
+            if (e->id == id)
+                return e->stats;
+    }
+    return {};
+}
+
+TaskStats Scheduler::stats(Device* device) const {
+    QMutexLocker locker(&mutex_);
+    TaskStats sum {};
+    for (auto& w : workers_) {
+        QMutexLocker wLocker(&w->mutex);
+        for (auto& e : w->tasks) {
+            if (e->device != device)
+                continue;
+            sum.runs += e->stats.runs;
+            sum.failures += e->stats.failures;
+            sum.misses += e->stats.misses;
+            sum.skipped += e->stats.skipped;
+            sum.rate += e->stats.rate;
+            sum.maxLateness = std::max(sum.maxLateness, e->stats.maxLateness);
+        }
+    }
+    return sum;
+}
+
+void Scheduler::start() {
+    QMutexLocker locker(&mutex_);
+    if (running_)
+        return;
+    running_ = true;
+    for (auto& w : workers_)
+        startWorker(*w);
+}
+
+void Scheduler::stop() {
+    QMutexLocker locker(&mutex_);
+    if (!running_)
+        return;
+    running_ = false;
+    std::vector<QThread*> threads;
+    for (auto& w : workers_) {
+        QMutexLocker wLocker(&w->mutex);
+        w->stop = true;
+        w->cv.wakeAll();
+        if (w->thread)
+            threads.emplace_back(std::exchange(w->thread, nullptr));
+    }
+    locker.unlock(); // задачи могут обращаться к планировщику
+    for (auto* thread : threads) {
+        thread->wait();
+        delete thread;
+    }
+}
+
+void Scheduler::startWorker(Worker& w) {
+    w.stop = false;
+    w.thread = QThread::create([this, &w] { run(w); });
+    w.thread->start();
+}
+
+void Scheduler::run(Worker& w) {
+    QMutexLocker locker(&w.mutex);
+    while (!w.stop) {
+        // готовая к запуску задача с наивысшим приоритетом и ближайшим сроком
+        const auto now = clock::now();
+        std::shared_ptr<Entry> next;
+        clock::time_point wakeup = clock::time_point::max();
+        for (auto& e : w.tasks) {
+            if (e->release > now) {
+                wakeup = std::min(wakeup, e->release);
+                continue;
+            }
+            if (!next || e->lane < next->lane
+                || (e->lane == next->lane && e->release + e->period < next->release + next->period))
+                next = e;
+        }
+
+        // разовая задача выполняется раньше периодической того же или более низкого приоритета
+        if (!w.oneShots.empty() && (!next || w.oneShots.front().lane <= next->lane)) {
+            OneShot job = std::move(w.oneShots.front());
+            w.oneShots.pop_front();
+            locker.unlock();
+            job.task();
+            locker.relock();
+            continue;
+        }
+
+        if (!next) {
+            if (wakeup == clock::time_point::max())
+                w.cv.wait(&w.mutex);
+            else
+                w.cv.wait(&w.mutex, QDeadlineTimer(duration_cast<milliseconds>(wakeup - now).count() + 1));
+            continue;
+        }
+
+        const auto deadline = next->release + next->period;
+        const qint64 lateness = duration_cast<milliseconds>(now - next->release).count();
+        Entry& e = *next;
+
+        locker.unlock();
+        const bool ok = e.task();
+        const auto finished = clock::now();
+        locker.relock();
+
+        auto& st = e.stats;
+        ++st.runs;
+        st.failures += !ok;
+        st.maxLateness = std::max(st.maxLateness, lateness);
+        if (e.lastRun != clock::time_point {}) {
+            const double hz = 1.0 / duration<double>(now - e.lastRun).count();
+            st.rate = st.rate ? st.rate * 0.9 + hz * 0.1 : hz;
+        }
+        e.lastRun = now;
+
+        if (finished > deadline) {
+            ++st.misses;
+            emit deadlineMissed(e.device, e.id, duration_cast<milliseconds>(finished - deadline).count());
+        }
+
+        // следующий запуск - начало очередного периода; пропущенные периоды не навёрстываются
+        e.release += e.period;
+        if (e.release < finished) {
+            const auto behind = (finished - e.release) / e.period + 1;
+            st.skipped += behind;
+            e.release += e.period * behind;
+        }
+    }
+}
+
+} // namespace Elemer
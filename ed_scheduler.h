@@ -0,0 +1,105 @@
+#pragma once
+
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QThread>
+#include <QWaitCondition>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace Elemer {
+
+class Device;
+class Port;
+
+/// приоритет задачи; при равном приоритете выбирается задача с ближайшим сроком
+enum class Lane : uint8_t {
+    Urgent,     // команды оператора (запись уставок и т.п.)
+    Normal,     // периодический опрос
+    Background, // служебные операции
+};
+
+struct TaskStats {
+    uint64_t runs {};
+    uint64_t failures {};
+    uint64_t misses {};     ///< запуск или завершение после срока
+    uint64_t skipped {};    ///< пропущенные периоды
+    double rate {};         ///< достигнутая частота, Гц (скользящее среднее)
+    qint64 maxLateness {};  ///< наибольшее опоздание запуска, мс
+};
+
+/// Планировщик опроса: транзакции каждого порта выполняются в отдельном потоке в порядке
+/// ближайшего срока (EDF) с учётом приоритета, срочные разовые команды обгоняют фоновый опрос.
+class Scheduler : public QObject {
+    Q_OBJECT
+
+public:
+    using clock = std::chrono::steady_clock;
+    using Task = std::function<bool()>;
+    using TaskId = int;
+
+    explicit Scheduler(QObject* parent = nullptr);
+    ~Scheduler();
+
+    /// периодическая задача; срок выполнения - начало следующего периода
+    TaskId addPeriodic(Device* device, std::chrono::milliseconds period, Task task, Lane lane = Lane::Normal);
+    void remove(TaskId id);
+    void removeAll(Device* device);
+
+    /// разовая задача, выполняется при первой возможности на порту прибора
+    /// раньше периодических задач того же или более низкого приоритета
+    void post(Device* device, Task task, Lane lane = Lane::Urgent);
+
+    TaskStats stats(TaskId id) const;
+    /// суммарная статистика задач прибора
+    TaskStats stats(Device* device) const;
+
+    void start();
+    void stop();
+    bool isRunning() const { return running_; }
+
+signals:
+    void deadlineMissed(Elemer::Device* device, int taskId, qint64 latenessMs);
+
+private:
+    struct Entry {
+        TaskId id;
+        Device* device;
+        Task task;
+        Lane lane;
+        clock::duration period;
+        clock::time_point release;
+        clock::time_point lastRun {};
+        TaskStats stats;
+    };
+
+    struct OneShot {
+        Device* device;
+        Task task;
+        Lane lane;
+    };
+
+    struct Worker {
+        QThread* thread {};
+        QMutex mutex;
+        QWaitCondition cv;
+        std::vector<std::shared_ptr<Entry>> tasks;
+        std::deque<OneShot> oneShots;
+        bool stop {};
+    };
+
+    Worker& worker(Device* device);
+    void run(Worker& w);
+    void startWorker(Worker& w);
+
+    mutable QMutex mutex_;
+    QMap<const Port*, std::shared_ptr<Worker>> workers_; ///< ключ - порт прибора, не его имя
+    TaskId lastId_ {};
+    bool running_ {};
+};
+
+} // namespace Elemer
@@ -0,0 +1,149 @@
+#include "ed_shm.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Elemer {
+
+namespace {
+
+constexpr uint32_t ShmMagic = 0x454C4D52; // "ELMR"
+constexpr uint32_t ShmVersion = 1;
+constexpr int ShmReadRetries = 1000; ///< предел попыток чтения записи, изменяемой публикатором
+
+constexpr size_t headerSize = (sizeof(detail::ShmHeader) + alignof(detail::ShmSlot) - 1) / alignof(detail::ShmSlot) * alignof(detail::ShmSlot);
+
+size_t segmentSize(uint32_t slotCount) { return headerSize + sizeof(detail::ShmSlot) * slotCount; }
+
+/// файл блокировки владельца имени: "/elemer" -> "/tmp/elemer.lock" (файл не удаляется)
+std::string lockPath(const std::string& name) {
+    const size_t start = name.find_first_not_of('/');
+    return "/tmp/" + (start == std::string::npos ? std::string {} : name.substr(start)) + ".lock";
+}
+
+} // namespace
+
+ShmPublisher::ShmPublisher(const std::string& name, uint32_t slotCount, bool unlinkOnClose)
+    : name_ { name }
+    , slotCount_ { slotCount }
+    , unlink_ { unlinkOnClose }
+    , size_ { segmentSize(slotCount) } {
+    // Владелец имени держит flock на файле блокировки до закрытия: второй публикатор с тем же
+    // именем получает отказ (isValid() == false), а не отбирает сегмент у работающего.
+    lockFd_ = ::open(lockPath(name).c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lockFd_ < 0)
+        return;
+    if (flock(lockFd_, LOCK_EX | LOCK_NB)) {
+        ::close(lockFd_), lockFd_ = -1;
+        return;
+    }
+    // Сегмент, оставшийся после аварийного завершения владельца, не переиспользуется:
+    // имя отвязывается (подключённые читатели сохраняют отображение), объект создаётся заново.
+    shm_unlink(name.c_str());
+    const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0)
+        return;
+    // новый объект после ftruncate заполнен нулями
+    void* ptr = ftruncate(fd, static_cast<off_t>(size_)) ? MAP_FAILED
+                                                         : mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        return;
+    }
+    data_ = reinterpret_cast<detail::ShmSlot*>(static_cast<char*>(ptr) + headerSize);
+    for (uint32_t i {}; i < slotCount_; ++i)
+        new (&data_[i]) detail::ShmSlot {};
+    header_ = new (ptr) detail::ShmHeader { 0, ShmVersion, slotCount_, ShmMaxChannels };
+    // читатели проверяют magic последним
+    std::atomic_ref(header_->magic).store(ShmMagic, std::memory_order_release);
+}
+
+ShmPublisher::~ShmPublisher() {
+    if (header_)
+        munmap(header_, size_);
+    if (header_ && unlink_)
+        shm_unlink(name_.c_str()); // имя принадлежит этому публикатору, пока открыт lockFd_
+    if (lockFd_ >= 0)
+        ::close(lockFd_); // снятие flock
+}
+
+void ShmPublisher::publish(uint32_t slot, DeviceType type, uint8_t address, const Samples& samples) noexcept {
+    if (!header_ || slot >= slotCount_)
+        return;
+    auto& s = data_[slot];
+    const uint32_t seq = s.seq.load(std::memory_order_relaxed);
+    s.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const size_t channels = std::min(samples.channels(), ShmMaxChannels);
+    s.sample.type = type;
+    s.sample.address = address;
+    s.sample.channels = static_cast<uint16_t>(channels);
+    s.sample.timestamp = samples.timestamp;
+    s.sample.sequence = samples.sequence;
+    std::copy_n(samples.values.begin(), channels, s.sample.values.begin());
+    std::copy_n(samples.status.begin(), channels, s.sample.status.begin());
+
+    s.seq.store(seq + 2, std::memory_order_release);
+}
+
+ShmReader::ShmReader(const std::string& name) {
+    const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return;
+    struct stat st {};
+    void* ptr = fstat(fd, &st) || static_cast<size_t>(st.st_size) < headerSize
+        ? MAP_FAILED
+        : mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (ptr == MAP_FAILED)
+        return;
+    size_ = st.st_size;
+    auto* header = static_cast<detail::ShmHeader*>(ptr);
+    if (std::atomic_ref(header->magic).load(std::memory_order_acquire) != ShmMagic
+        || header->version != ShmVersion
+        || header->maxChannels != ShmMaxChannels
+        || segmentSize(header->slotCount) > size_) {
+        munmap(ptr, size_);
+        return;
+    }
+    header_ = header;
+    data_ = reinterpret_cast<const detail::ShmSlot*>(static_cast<const char*>(ptr) + headerSize);
+}
+
+ShmReader::~ShmReader() {
+    if (header_)
+        munmap(const_cast<detail::ShmHeader*>(header_), size_);
+}
+
+bool ShmReader::read(uint32_t slot, ShmSample& out) const noexcept {
+    if (!header_ || slot >= header_->slotCount)
+        return false;
+    const auto& s = data_[slot];
+    // публикатор мог завершиться посреди записи - тогда seq остаётся нечётным навсегда
+    for (int retry {}; retry < ShmReadRetries; ++retry) {
+        const uint32_t seq1 = s.seq.load(std::memory_order_acquire);
+        if (seq1 & 1)
+            continue; // идёт запись
+        if (!seq1)
+            return false;
+        std::memcpy(&out, &s.sample, sizeof(ShmSample));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.seq.load(std::memory_order_relaxed) == seq1)
+            return true;
+    }
+    return false;
+}
+
+uint64_t ShmReader::sequence(uint32_t slot) const noexcept {
+    ShmSample sample;
+    return read(slot, sample) ? sample.sequence : 0;
+}
+
+} // namespace Elemer
@@ -0,0 +1,99 @@
+#pragma once
+
+// Публикация последних измерений в разделяемой памяти POSIX для локальных процессов
+// (HMI, архив, сервер тревог). Каждая запись защищена своим seqlock: писатель не ждёт
+// читателей, читатели не выполняют системных вызовов и не обращаются к линии.
+
+#include "ed_common_types.h"
+#include "ed_samples.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace Elemer {
+
+/// наибольшее число каналов прибора (ИРТМ-2405)
+inline constexpr size_t ShmMaxChannels = 128;
+
+/// последние измерения прибора
+struct ShmSample {
+    DeviceType type {};
+    uint8_t address {};
+    uint16_t channels {};
+    int64_t timestamp {}; ///< нс от эпохи system_clock
+    uint64_t sequence {}; ///< номер опроса
+    std::array<float, ShmMaxChannels> values {};
+    std::array<SampleStatus, ShmMaxChannels> status {};
+};
+
+namespace detail {
+
+struct ShmHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t maxChannels;
+};
+
+struct alignas(64) ShmSlot {
+    std::atomic<uint32_t> seq;
+    ShmSample sample;
+};
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+} // namespace detail
+
+/// Владелец сегмента разделяемой памяти; запись выполняет один поток на запись (slot)
+class ShmPublisher {
+public:
+    /// name - имя объекта shm_open ("/elemer"), slotCount - число приборов;
+    /// isValid() == false, если имя занято работающим публикатором другого процесса
+    ShmPublisher(const std::string& name, uint32_t slotCount, bool unlinkOnClose = true);
+    ~ShmPublisher();
+
+    ShmPublisher(const ShmPublisher&) = delete;
+    ShmPublisher& operator=(const ShmPublisher&) = delete;
+
+    bool isValid() const noexcept { return header_ != nullptr; }
+    uint32_t slotCount() const noexcept { return slotCount_; }
+
+    void publish(uint32_t slot, DeviceType type, uint8_t address, const Samples& samples) noexcept;
+
+private:
+    std::string name_;
+    uint32_t slotCount_ {};
+    bool unlink_ {};
+    size_t size_ {};
+    int lockFd_ = -1; ///< flock владельца имени сегмента
+    detail::ShmHeader* header_ {};
+    detail::ShmSlot* data_ {};
+};
+
+/// Читатель сегмента, созданного ShmPublisher в другом процессе
+class ShmReader {
+public:
+    explicit ShmReader(const std::string& name);
+    ~ShmReader();
+
+    ShmReader(const ShmReader&) = delete;
+    ShmReader& operator=(const ShmReader&) = delete;
+
+    bool isValid() const noexcept { return header_ != nullptr; }
+    uint32_t slotCount() const noexcept { return header_ ? header_->slotCount : 0; }
+
+    /// согласованная копия записи; false, если запись ещё не публиковалась, номер вне диапазона
+    /// или запись не удалось прочитать согласованно (публикатор завершился посреди записи)
+    bool read(uint32_t slot, ShmSample& out) const noexcept;
+    /// номер последнего опроса без копирования значений
+    uint64_t sequence(uint32_t slot) const noexcept;
+
+private:
+    size_t size_ {};
+    const detail::ShmHeader* header_ {};
+    const detail::ShmSlot* data_ {};
+};
+
+} // namespace Elemer
@@ -0,0 +1,370 @@
+#include "ed_store.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Elemer {
+
+namespace {
+
+constexpr uint32_t StoreMagic = 0x534D4C45; // "ELMS"
+constexpr uint32_t BlockMagic = 0x4B4C4245; // "EBLK"
+constexpr uint32_t StoreVersion = 1;
+
+constexpr size_t segmentBytes = size_t { Store::BlockSize } * Store::SegmentBlocks;
+constexpr size_t capacityBits = (Store::BlockSize - sizeof(detail::StoreBlock)) * 8;
+/// наибольшая длина закодированного отсчёта: время '11111'+64, значение '11'+5+5+32
+constexpr size_t maxSampleBits = 69 + 44;
+
+static_assert(sizeof(detail::StoreHeader) <= Store::BlockSize);
+
+/// битовый поток блока, младшие биты первыми; область данных нового блока заполнена нулями
+class BitWriter {
+public:
+    BitWriter(uint8_t* data, size_t pos)
+        : data_ { data }
+        , pos_ { pos } { }
+
+    void put(uint64_t value, unsigned n) noexcept {
+        while (n) {
+            const unsigned offset = pos_ & 7;
+            const unsigned take = std::min(8 - offset, n);
+            data_[pos_ >> 3] |= static_cast<uint8_t>((value & ((1u << take) - 1)) << offset);
+            value >>= take;
+            n -= take;
+            pos_ += take;
+        }
+    }
+
+    size_t pos() const noexcept { return pos_; }
+
+private:
+    uint8_t* data_;
+    size_t pos_;
+};
+
+class BitReader {
+public:
+    explicit BitReader(const uint8_t* data)
+        : data_ { data } { }
+
+    uint64_t get(unsigned n) noexcept {
+        uint64_t value {};
+        for (unsigned done {}; done < n;) {
+            const unsigned offset = pos_ & 7;
+            const unsigned take = std::min(8 - offset, n - done);
+            value |= static_cast<uint64_t>((data_[pos_ >> 3] >> offset) & ((1u << take) - 1)) << done;
+            done += take;
+            pos_ += take;
+        }
+        return value;
+    }
+
+private:
+    const uint8_t* data_;
+    size_t pos_ {};
+};
+
+/// ширина поля разности второго порядка по числу единиц префикса (1..5)
+constexpr unsigned dodWidth[] { 0, 7, 9, 12, 32, 64 };
+
+constexpr bool fitsSigned(int64_t v, unsigned bits) noexcept {
+    return v >= -(int64_t { 1 } << (bits - 1)) && v < (int64_t { 1 } << (bits - 1));
+}
+
+void putDod(BitWriter& w, int64_t dod) noexcept {
+    if (!dod) {
+        w.put(0, 1);
+        return;
+    }
+    for (unsigned ones = 1; ones < 5; ++ones) {
+        if (fitsSigned(dod, dodWidth[ones])) {
+            w.put((1u << ones) - 1, ones + 1); // ones единиц и ноль
+            w.put(static_cast<uint64_t>(dod), dodWidth[ones]);
+            return;
+        }
+    }
+    w.put(0b11111, 5);
+    w.put(static_cast<uint64_t>(dod), 64);
+}
+
+int64_t getDod(BitReader& r) noexcept {
+    unsigned ones {};
+    while (ones < 5 && r.get(1))
+        ++ones;
+    if (!ones)
+        return 0;
+    const unsigned width = dodWidth[ones];
+    const uint64_t raw = r.get(width);
+    return width == 64 ? static_cast<int64_t>(raw) : static_cast<int64_t>(raw << (64 - width)) >> (64 - width);
+}
+
+uint8_t* payload(detail::StoreBlock* block) noexcept { return reinterpret_cast<uint8_t*>(block + 1); }
+const uint8_t* payload(const detail::StoreBlock* block) noexcept { return reinterpret_cast<const uint8_t*>(block + 1); }
+
+uint32_t loadCount(const detail::StoreBlock* block) noexcept {
+    return std::atomic_ref(const_cast<uint32_t&>(block->count)).load(std::memory_order_acquire);
+}
+
+} // namespace
+
+Store::Store(const std::string& path, std::chrono::nanoseconds timeQuantum, Mode mode)
+    : readOnly_ { mode == Mode::ReadOnly } {
+    fd_ = readOnly_ ? ::open(path.c_str(), O_RDONLY | O_CLOEXEC)
+                    : ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+        return;
+    struct stat st {};
+    // читатель не блокирует файл: писатель дописывает данные, не изменяя закрытые блоки
+    if ((!readOnly_ && flock(fd_, LOCK_EX | LOCK_NB)) || fstat(fd_, &st)) { // архив уже пишет другой процесс
+        ::close(fd_), fd_ = -1;
+        return;
+    }
+
+    const size_t segments = static_cast<size_t>(st.st_size) / segmentBytes;
+    if (!st.st_size) { // новый архив
+        if (readOnly_)
+            return;
+        if (!grow())
+            return;
+        auto* header = reinterpret_cast<detail::StoreHeader*>(segments_[0]);
+        *header = { StoreMagic, StoreVersion, BlockSize, SegmentBlocks, std::max<int64_t>(timeQuantum.count(), 1) };
+        header_ = header;
+        quantum_ = header->timeQuantum;
+        nextBlock_ = 1;
+        return;
+    }
+    const int protection = readOnly_ ? PROT_READ : PROT_READ | PROT_WRITE;
+    for (size_t i {}; i < segments; ++i) {
+        void* ptr = mmap(nullptr, segmentBytes, protection, MAP_SHARED, fd_, static_cast<off_t>(i * segmentBytes));
+        if (ptr == MAP_FAILED)
+            return;
+        segments_.push_back(static_cast<char*>(ptr));
+    }
+    auto* header = segments_.empty() ? nullptr : reinterpret_cast<detail::StoreHeader*>(segments_[0]);
+    if (!header || header->magic != StoreMagic || header->version != StoreVersion
+        || header->blockSize != BlockSize || header->segmentBlocks != SegmentBlocks || header->timeQuantum <= 0)
+        return;
+    quantum_ = header->timeQuantum;
+
+    // восстановление индекса по заголовкам блоков; запись после перезапуска
+    // продолжается в новых блоках
+    nextBlock_ = 1;
+    const uint32_t total = static_cast<uint32_t>(segments_.size() * SegmentBlocks);
+    for (uint32_t i = 1; i < total; ++i) {
+        detail::StoreBlock* block = blockAt(i);
+        if (block->magic != BlockMagic)
+            continue;
+        nextBlock_ = i + 1;
+        if (!loadCount(block)) // блок мог быть только что начат писателем
+            continue;
+        Series& s = series_[seriesLocked({ block->device, block->channel })];
+        s.blocks.push_back({ block->first, i });
+        s.prevTime = std::max(s.prevTime, block->last);
+    }
+    header_ = header;
+}
+
+Store::~Store() {
+    for (char* segment : segments_)
+        munmap(segment, segmentBytes);
+    if (fd_ >= 0)
+        ::close(fd_);
+}
+
+bool Store::grow() {
+    const off_t offset = static_cast<off_t>(segments_.size() * segmentBytes);
+    if (ftruncate(fd_, offset + static_cast<off_t>(segmentBytes)))
+        return false;
+    void* ptr = mmap(nullptr, segmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, offset);
+    if (ptr == MAP_FAILED)
+        return false;
+    segments_.push_back(static_cast<char*>(ptr));
+    return true;
+}
+
+detail::StoreBlock* Store::blockAt(uint32_t index) const noexcept {
+    return reinterpret_cast<detail::StoreBlock*>(segments_[index / SegmentBlocks] + size_t { index % SegmentBlocks } * BlockSize);
+}
+
+int Store::series(SeriesKey key) {
+    std::lock_guard lock(mutex_);
+    return isValid() && !readOnly_ ? seriesLocked(key) : -1;
+}
+
+int Store::seriesLocked(SeriesKey key) {
+    auto [it, inserted] = index_.try_emplace(keyOf(key), static_cast<int>(series_.size()));
+    if (inserted)
+        series_.emplace_back().key = key;
+    return it->second;
+}
+
+bool Store::append(int series, int64_t time, float value) {
+    std::lock_guard lock(mutex_);
+    if (!isValid() || readOnly_ || series < 0 || static_cast<size_t>(series) >= series_.size())
+        return false;
+    return appendLocked(series_[series], time, value);
+}
+
+void Store::append(uint32_t device, const Samples& samples) {
+    std::lock_guard lock(mutex_);
+    if (!isValid() || readOnly_)
+        return;
+    for (size_t ch {}; ch < samples.channels(); ++ch) {
+        if (samples.status[ch] == SampleStatus::Ok)
+            appendLocked(series_[seriesLocked({ device, static_cast<uint16_t>(ch) })], samples.timestamp, samples.values[ch]);
+    }
+}
+
+bool Store::appendLocked(Series& s, int64_t time, float value) {
+    const int64_t t = time / quantum_;
+    const uint32_t bits = std::bit_cast<uint32_t>(value);
+    if (t < s.prevTime && (s.open || !s.blocks.empty()))
+        return false;
+    detail::StoreBlock* block = s.open;
+    if (!block || block->bits + maxSampleBits > capacityBits)
+        return startBlock(s, t, bits);
+
+    BitWriter w(payload(block), block->bits);
+    const int64_t delta = t - s.prevTime;
+    putDod(w, delta - s.prevDelta);
+
+    const uint32_t x = bits ^ s.prevValue;
+    if (!x) {
+        w.put(0, 1);
+    } else {
+        const uint8_t leading = static_cast<uint8_t>(std::countl_zero(x));
+        const uint8_t trailing = static_cast<uint8_t>(std::countr_zero(x));
+        if (s.window && leading >= s.leading && trailing >= s.trailing) {
+            w.put(0b01, 2);
+            w.put(x >> s.trailing, 32 - s.leading - s.trailing);
+        } else {
+            const unsigned length = 32 - leading - trailing;
+            w.put(0b11, 2);
+            w.put(leading, 5);
+            w.put(length - 1, 5);
+            w.put(x >> trailing, length);
+            s.leading = leading, s.trailing = trailing, s.window = true;
+        }
+    }
+
+    s.prevDelta = delta;
+    s.prevTime = t;
+    s.prevValue = bits;
+    block->last = t;
+    block->bits = static_cast<uint32_t>(w.pos());
+    std::atomic_ref(block->count).store(block->count + 1, std::memory_order_release);
+    return true;
+}
+
+bool Store::startBlock(Series& s, int64_t t, uint32_t value) {
+    if (s.open)
+        s.open->sealed = 1;
+    s.open = nullptr;
+    if (nextBlock_ >= segments_.size() * SegmentBlocks && !grow())
+        return false;
+    const uint32_t index = nextBlock_++;
+    detail::StoreBlock* block = blockAt(index);
+    block->device = s.key.device;
+    block->channel = s.key.channel;
+    block->first = block->last = t;
+    BitWriter w(payload(block), 0);
+    w.put(value, 32);
+    block->bits = static_cast<uint32_t>(w.pos());
+    block->magic = BlockMagic;
+    std::atomic_ref(block->count).store(1, std::memory_order_release);
+
+    s.blocks.push_back({ t, index });
+    s.open = block;
+    s.prevTime = t;
+    s.prevDelta = 0;
+    s.prevValue = value;
+    s.window = false;
+    return true;
+}
+
+size_t Store::query(SeriesKey key, int64_t from, int64_t to, std::vector<Point>& out) const {
+    const size_t before = out.size();
+    std::vector<const detail::StoreBlock*> blocks;
+    const detail::StoreBlock* open {};
+    {
+        std::lock_guard lock(mutex_);
+        const auto it = index_.find(keyOf(key));
+        if (!isValid() || it == index_.end() || from > to)
+            return 0;
+        const Series& s = series_[it->second];
+        // первый блок, который может содержать from: последний с началом не позже from
+        auto b = std::upper_bound(s.blocks.begin(), s.blocks.end(), from / quantum_,
+            [](int64_t t, const BlockRef& ref) { return t < ref.first; });
+        if (b != s.blocks.begin())
+            --b;
+        for (; b != s.blocks.end() && b->first <= to / quantum_; ++b)
+            blocks.push_back(blockAt(b->index));
+        if (!blocks.empty() && blocks.back() == s.open)
+            open = s.open, blocks.pop_back();
+    }
+    // закрытые блоки не изменяются - разбор без блокировки
+    for (const detail::StoreBlock* block : blocks)
+        decode(block, from, to, out);
+    if (open) {
+        std::lock_guard lock(mutex_);
+        decode(open, from, to, out);
+    }
+    return out.size() - before;
+}
+
+void Store::decode(const detail::StoreBlock* block, int64_t from, int64_t to, std::vector<Point>& out) const {
+    const uint32_t count = loadCount(block);
+    BitReader r(payload(block));
+    int64_t t = block->first;
+    int64_t delta {};
+    uint32_t value = static_cast<uint32_t>(r.get(32));
+    unsigned leading {}, trailing {};
+    for (uint32_t i {};;) {
+        const int64_t time = t * quantum_;
+        if (time > to)
+            return;
+        if (time >= from)
+            out.push_back({ time, std::bit_cast<float>(value) });
+        if (++i >= count)
+            return;
+        delta += getDod(r);
+        t += delta;
+        if (r.get(1)) {
+            if (r.get(1)) {
+                leading = static_cast<unsigned>(r.get(5));
+                const unsigned length = static_cast<unsigned>(r.get(5)) + 1;
+                trailing = 32 - leading - length;
+            }
+            value ^= static_cast<uint32_t>(r.get(32 - leading - trailing)) << trailing;
+        }
+    }
+}
+
+std::vector<SeriesKey> Store::seriesList() const {
+    std::lock_guard lock(mutex_);
+    std::vector<SeriesKey> keys;
+    keys.reserve(series_.size());
+    for (const Series& s : series_)
+        keys.push_back(s.key);
+    return keys;
+}
+
+bool Store::sync() {
+    std::lock_guard lock(mutex_);
+    bool ok = isValid();
+    if (readOnly_)
+        return ok;
+    for (char* segment : segments_)
+        ok &= !msync(segment, segmentBytes, MS_SYNC);
+    return ok;
+}
+
+} // namespace Elemer
@@ -0,0 +1,137 @@
+#pragma once
+
+// Архив измерений: файл только для дописывания, отображаемый в память (POSIX mmap).
+// Каждый ряд (прибор, канал) хранится блоками фиксированного размера; в блоке время сжато
+// разностью второго порядка, значения - XOR с предыдущим (схема Gorilla). Блоки ряда
+// упорядочены по времени, индекс по времени первого отсчёта строится при открытии файла.
+
+#include "ed_history.h"
+#include "ed_samples.h"
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Elemer {
+
+/// ключ ряда архива
+struct SeriesKey {
+    uint32_t device {}; ///< идентификатор прибора, например (тип << 8) | адрес
+    uint16_t channel {};
+
+    constexpr bool operator==(const SeriesKey&) const = default;
+};
+
+namespace detail {
+
+struct StoreHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t blockSize;
+    uint32_t segmentBlocks;
+    int64_t timeQuantum; ///< единица хранения времени, нс
+};
+
+/// заголовок блока ряда; count публикуется последним после записи отсчёта
+struct StoreBlock {
+    uint32_t magic;
+    uint32_t device;
+    uint16_t channel;
+    uint16_t sealed; ///< блок закрыт для записи
+    uint32_t count;  ///< число отсчётов
+    uint32_t bits;   ///< длина битового потока
+    uint32_t reserved;
+    int64_t first; ///< время первого отсчёта, кванты
+    int64_t last;  ///< время последнего отсчёта, кванты
+};
+
+} // namespace detail
+
+/// Архив рядов измерений в одном файле. Запись и запросы допускаются из любых потоков;
+/// файл открывается на запись только одним процессом. Время отсчётов ряда не должно убывать.
+class Store {
+public:
+    static constexpr uint32_t BlockSize = 4096;
+    static constexpr uint32_t SegmentBlocks = 4096; ///< файл растёт сегментами по 16 МБ
+
+    enum class Mode : uint8_t {
+        ReadWrite, ///< эксклюзивная запись (flock LOCK_EX), архив создаётся при отсутствии
+        ReadOnly,  ///< только запросы, без блокировки: допускается при работающем писателе
+    };
+
+    /// Открытие или создание архива; timeQuantum (точность хранения времени) задаётся при создании.
+    /// В режиме ReadOnly видны сегменты, существовавшие на момент открытия.
+    explicit Store(const std::string& path, std::chrono::nanoseconds timeQuantum = std::chrono::milliseconds(1),
+        Mode mode = Mode::ReadWrite);
+    ~Store();
+
+    Store(const Store&) = delete;
+    Store& operator=(const Store&) = delete;
+
+    bool isValid() const noexcept { return header_ != nullptr; }
+    bool isReadOnly() const noexcept { return readOnly_; }
+    std::chrono::nanoseconds timeQuantum() const noexcept { return std::chrono::nanoseconds(quantum_); }
+
+    /// номер ряда для append() (ряд создаётся при первом обращении), -1 при ошибке или только для чтения
+    int series(SeriesKey key);
+
+    /// дописывание отсчёта (время в нс от эпохи system_clock); false - время убывает, нет места
+    /// или архив открыт только для чтения
+    bool append(int series, int64_t time, float value);
+
+    /// дописывание всех каналов с состоянием Ok одного опроса прибора device
+    void append(uint32_t device, const Samples& samples);
+
+    /// Отсчёты ряда с временем в [from, to] (нс) дописываются в out по возрастанию времени;
+    /// возвращает их число
+    size_t query(SeriesKey key, int64_t from, int64_t to, std::vector<Point>& out) const;
+
+    std::vector<SeriesKey> seriesList() const;
+
+    /// запись изменённых страниц на диск
+    bool sync();
+
+private:
+    struct BlockRef {
+        int64_t first; ///< время первого отсчёта, кванты
+        uint32_t index;
+    };
+
+    struct Series {
+        SeriesKey key;
+        std::vector<BlockRef> blocks;
+        // состояние кодера открытого блока
+        detail::StoreBlock* open {};
+        int64_t prevTime {};
+        int64_t prevDelta {};
+        uint32_t prevValue {};
+        uint8_t leading {};
+        uint8_t trailing {};
+        bool window {};
+    };
+
+    static constexpr uint64_t keyOf(SeriesKey key) noexcept { return (uint64_t { key.device } << 16) | key.channel; }
+
+    int seriesLocked(SeriesKey key);
+    bool appendLocked(Series& s, int64_t time, float value);
+    bool startBlock(Series& s, int64_t t, uint32_t value);
+    bool grow();
+    detail::StoreBlock* blockAt(uint32_t index) const noexcept;
+    void decode(const detail::StoreBlock* block, int64_t from, int64_t to, std::vector<Point>& out) const;
+
+    int fd_ = -1;
+    bool readOnly_ {};
+    detail::StoreHeader* header_ {};
+    int64_t quantum_ { 1 };
+    std::vector<char*> segments_;
+    uint32_t nextBlock_ {};
+    std::deque<Series> series_;
+    std::unordered_map<uint64_t, int> index_;
+    mutable std::mutex mutex_;
+};
+
+} // namespace Elemer
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "ed_core.h"
 // Qt
 #include <QByteArray>
 #include <QDebug>
@@ -22,14 +23,6 @@ concept hex_convertible = requires {
 };
 
 ///////////////////////////////////////////
-/// убирание разделителя из формируемой посылки
-struct SkipSemicolon {
-};
-
-/// добавление разделителя в формируемую посылку
-struct Semicolon {
-};
-
 /// обёртка над std::span для удобства хранения указателя и размена куска из буфера данных
 struct Span {
     using span = std::span<char>;
@@ -92,19 +85,26 @@ struct ToHex {
     operator QByteArray() const noexcept { return hex; }
     size_t size() const noexcept { return hex.size(); }
 
+    /// образ памяти в НЕХ формате; кодирование выполняет Core::toHex
+    static QByteArray encode(std::span<const std::byte> bytes) {
+        QByteArray hex(static_cast<int>(bytes.size() * 2), Qt::Uninitialized);
+        Core::toHex(bytes, { hex.data(), static_cast<size_t>(hex.size()) });
+        return hex;
+    }
+
     template <typename T>
     static auto toHex(T&& val) requires(std::is_arithmetic_v<std::decay_t<T>> || std::is_enum_v<std::decay_t<T>>) {
-        return QByteArray(reinterpret_cast<const char*>(&val), sizeof(std::decay_t<T>)).toHex().toUpper();
+        return encode(std::as_bytes(std::span(&val, 1)));
     }
 
     template <typename T>
     static auto toHex(T&& val) requires std::is_same_v<std::decay_t<T>, QString> {
-        return val.toLocal8Bit().toHex().toUpper();
+        return toHex(val.toLocal8Bit());
     }
 
     template <typename T>
     static auto toHex(T&& val) requires std::is_same_v<std::decay_t<T>, QByteArray> {
-        return val.toHex().toUpper();
+        return encode(std::as_bytes(std::span(val.constData(), static_cast<size_t>(val.size()))));
     }
 
     template <typename T>
@@ -113,23 +113,22 @@ struct ToHex {
     }
 };
 
-/// обёртка для получения значения типа "Т" из Hex формата
+/// обёртка для получения значения типа "Т" из Hex формата;
+/// декодирование строгое (Core::fromHex), при ошибке val не изменяется и ok == false
 template <typename T>
 struct FromHex {
     T& val;
+    bool ok {};
     using value_type = T;
 
     operator T&() const noexcept { return val; }
     operator T&() noexcept { return val; }
 
-    auto operator=(const Span& arr) requires(hex_convertible<T>&& std::is_array_v<T>) {
-        auto data { QByteArray::fromHex(arr) };
-        std::memcpy(val, data.data(), data.size());
-        return (*this);
-    }
-
-    auto operator=(const Span& arr) requires(hex_convertible<T> && !std::is_array_v<T>) {
-        val = *reinterpret_cast<T*>(QByteArray::fromHex(arr).data());
+    auto operator=(const Span& arr) requires hex_convertible<T> {
+        std::array<std::byte, sizeof(T)> data;
+        ok = Core::fromHex({ arr.data.data(), arr.data.size() }, data) == static_cast<ptrdiff_t>(sizeof(T));
+        if (ok)
+            std::memcpy(&val, data.data(), sizeof(T));
         return (*this);
     }
 };
@@ -160,6 +159,8 @@ template <typename T>
 FromStr(T&) -> FromStr<T>; // template deduction guide
 
 /// Формирование посылкм из данных переданных в конструктор
+/// Посылка без CRC для Qt-транспорта; поля формирует Core::FrameBuilder,
+/// здесь только преобразование типов Qt
 struct Parcel {
     QByteArray data;
 
@@ -169,79 +170,32 @@ struct Parcel {
     Parcel& operator=(const Parcel&) = default;
 
     template <typename... Ts>
-    Parcel(Ts&&... args) {
-        data.reserve(255);
-        data.append(-1);
-        data.append(':');
-        (func(std::forward<Ts>(args)), ...);
+    Parcel(Ts&&... args)
+        requires(!(std::is_same_v<std::remove_cvref_t<Ts>, Parcel> || ...)) {
+        Core::FrameBuilder frame;
+        (func(frame, std::forward<Ts>(args)), ...);
+        if (!frame.ok())
+            qDebug() << "Parcel: value out of range";
+        const std::string_view view = frame.view();
+        data = QByteArray(view.data(), static_cast<int>(view.size()));
     }
 
     operator QByteArray() const { return data; }
 
-    // integral
-    template <typename T>
-    void func(T arg) requires std::is_integral_v<std::decay_t<T>> {
-        std::array<char, 16> str { 0 };
-        auto [ptr, ec] = std::to_chars(str.data(), str.data() + str.size(), arg);
-        if (!(ec == std::errc {}))
-            qDebug() << static_cast<int>(ec);
-        *ptr = ';';
-        data.append(str.data());
-    }
-
-    // enum
-    template <typename T>
-    void func(T arg) requires std::is_enum_v<std::decay_t<T>> {
-        std::array<char, 16> str { 0 };
-        auto [ptr, ec] = std::to_chars(str.data(), str.data() + str.size(), static_cast<long>(arg));
-        if (!(ec == std::errc {}))
-            qDebug() << static_cast<int>(ec);
-        *ptr = ';';
-        data.append(str.data());
-    }
-
-    // floating point
-    template <typename T>
-    void func(T arg) requires std::is_floating_point_v<std::decay_t<T>> {
-        std::array<char, 16> str { 0 };
-        auto [ptr, ec] = std::to_chars(str.data(), str.data() + str.size(), arg, std::chars_format::fixed, 5);
-        if (!(ec == std::errc {}))
-            qDebug() << static_cast<int>(ec);
-        *ptr = ';';
-        data.append(str.data());
-    }
-
-    // ToHex
-    template <typename T>
-    void func(T&& arg) requires std::is_same_v<std::decay_t<T>, ToHex> {
-        assert(arg.size());
-        data.append(arg).append(';');
-    }
-
-    // QByteArray
-    template <typename T>
-    void func(T&& arg) requires std::is_same_v<std::decay_t<T>, QByteArray> {
+private:
+    static std::string_view field(const QByteArray& arg) {
         assert(arg.size());
-        data.append(arg).append(';');
-    }
-
-    // QString
-    template <typename T>
-    void func(T&& arg) requires std::is_same_v<std::decay_t<T>, QString> {
-        assert(arg.size());
-        data.append(arg.toLocal8Bit()).append(';');
-    }
-
-    // SkipSemicolon
-    template <typename T>
-    void func(T) requires std::is_same_v<std::decay_t<T>, SkipSemicolon> {
-        data.resize(data.size() - 1);
+        return { arg.constData(), static_cast<size_t>(arg.size()) };
     }
 
-    // Semicolon
     template <typename T>
-    void func(T) requires std::is_same_v<std::decay_t<T>, Semicolon> {
-        data.append(';');
+    static void func(Core::FrameBuilder& frame, const T& arg) {
+        if constexpr (std::is_same_v<T, QString>)
+            frame.append(field(arg.toLocal8Bit()));
+        else if constexpr (std::is_same_v<T, ToHex> || std::is_same_v<T, QByteArray>)
+            frame.append(field(arg));
+        else // integral, enum, floating point, Semicolon, SkipSemicolon
+            frame.append(arg);
     }
 };
 
@@ -0,0 +1,109 @@
+#include "ed_gateway.h"
+#include "ed_device.h"
+
+#include <algorithm>
+
+namespace Elemer {
+
+Gateway::Gateway(Scheduler* scheduler, QObject* parent)
+    : QObject(parent)
+    , scheduler_ { scheduler } {
+}
+
+Gateway::~Gateway() {
+    // задачи основного опроса тех же приборов шлюзу не принадлежат и не удаляются
+    *closed_ = true;
+}
+
+bool Gateway::listen(Device* device, const QString& name) {
+    auto* server = new QLocalServer(this);
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+    QLocalServer::removeServer(name); // сокет, оставшийся после аварийного завершения
+    if (!server->listen(name)) {
+        emit message(name + ": " + server->errorString());
+        delete server;
+        return false;
+    }
+    servers_.emplace(server, device);
+    connect(server, &QLocalServer::newConnection, this, [this, server, device] { onNewConnection(server, device); });
+    return true;
+}
+
+void Gateway::onNewConnection(QLocalServer* server, Device* device) {
+    while (QLocalSocket* socket = server->nextPendingConnection()) {
+        auto client = std::make_shared<Client>();
+        client->socket = socket;
+        client->device = device;
+        clients_.emplace(socket, client);
+        connect(socket, &QLocalSocket::readyRead, this, [this, client] { onReadyRead(client); });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket] {
+            clients_.erase(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void Gateway::onReadyRead(const std::shared_ptr<Client>& client) {
+    client->buffer.append(client->socket->readAll());
+    for (int end; (end = client->buffer.indexOf('\r')) >= 0;) {
+        QByteArray frame = client->buffer.left(end + 1);
+        client->buffer.remove(0, end + 1);
+        // начало посылки - "\xFF:", всё до него отбрасывается
+        if (int start = frame.indexOf("\xFF:"); start >= 0)
+            submit(client, frame.mid(start));
+    }
+    if (client->buffer.size() > 1024) // клиент не соблюдает формат
+        client->buffer.clear();
+}
+
+void Gateway::Bucket::fill(double rate, double burst) {
+    if (!refill.isValid()) { // новое ведро полное
+        tokens = burst;
+        refill.start();
+        return;
+    }
+    tokens = std::min(burst, tokens + refill.restart() / 1000.0 * rate);
+}
+
+bool Gateway::takeToken(Client& client) {
+    Bucket& line = lines_[client.device];
+    client.bucket.fill(quota_.rate, quota_.burst);
+    line.fill(quota_.lineRate, quota_.lineBurst);
+    if (client.bucket.tokens < 1.0 || line.tokens < 1.0)
+        return false;
+    client.bucket.tokens -= 1.0;
+    line.tokens -= 1.0;
+    return true;
+}
+
+void Gateway::submit(const std::shared_ptr<Client>& client, const QByteArray& frame) {
+    if (Device::changesLink(Device::rawCommand(frame))) {
+        client->socket->write("#denied\r");
+        return;
+    }
+    if (client->pending >= quota_.maxPending || !takeToken(*client)) {
+        client->socket->write("#busy\r");
+        return;
+    }
+    ++client->pending;
+    QPointer<Gateway> self { this };
+    scheduler_->post(
+        client->device, [self, closed = closed_, client, frame] {
+            if (*closed)
+                return false;
+            Device* device = client->device;
+            const QByteArray reply = device->transactRaw(frame, std::max(2 * device->info().Timeout, 500), false);
+            if (self)
+                QMetaObject::invokeMethod(
+                    self, [client, reply] {
+                        --client->pending;
+                        if (client->socket)
+                            client->socket->write(reply.isEmpty() ? QByteArray("#timeout\r") : reply);
+                    },
+                    Qt::QueuedConnection);
+            return !reply.isEmpty();
+        },
+        lane_);
+}
+
+} // namespace Elemer
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "ed_scheduler.h"
+
+#include <QElapsedTimer>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QPointer>
+#include <atomic>
+#include <map>
+#include <memory>
+
+namespace Elemer {
+
+class Device;
+
+/// Шлюз: принимает посылки протокола ЭЛЕМЕР ("\xFF:...;CRC\r") от локальных клиентов через
+/// Unix-сокет и выполняет их на линии прибора через планировщик, чередуя с основным опросом.
+/// Ответ прибора пересылается клиенту без изменений; при отказе шлюз отвечает служебной
+/// строкой: "#busy\r" - превышена квота клиента, "#timeout\r" - прибор не ответил,
+/// "#denied\r" - команда смены адреса или скорости прибора (Device::changesLink).
+class Gateway : public QObject {
+    Q_OBJECT
+
+public:
+    struct Quota {
+        int maxPending = 4;  ///< посылок одного клиента в очереди
+        double rate = 20.0;  ///< транзакций клиента в секунду в среднем
+        double burst = 10.0; ///< допустимый всплеск клиента
+        double lineRate = 20.0;  ///< транзакций всех клиентов линии в секунду в среднем
+        double lineBurst = 10.0; ///< допустимый всплеск всех клиентов линии
+    };
+
+    explicit Gateway(Scheduler* scheduler, QObject* parent = nullptr);
+    ~Gateway();
+
+    /// обслуживание линии прибора device через локальный сокет name
+    bool listen(Device* device, const QString& name);
+
+    void setQuota(const Quota& quota) { quota_ = quota; }
+    /// Приоритет клиентских транзакций относительно основного опроса. По умолчанию Background:
+    /// разовая задача своего приоритета обгоняет периодическую, поэтому при Normal клиенты
+    /// могли бы вытеснить просроченный основной опрос.
+    void setLane(Lane lane) { lane_ = lane; }
+
+signals:
+    void message(const QString&, int timout = {});
+
+private:
+    /// квота "маркерное ведро"
+    struct Bucket {
+        double tokens {};
+        QElapsedTimer refill;
+
+        void fill(double rate, double burst);
+    };
+
+    struct Client {
+        QPointer<QLocalSocket> socket;
+        Device* device;
+        QByteArray buffer;
+        int pending {};
+        Bucket bucket;
+    };
+
+    void onNewConnection(QLocalServer* server, Device* device);
+    void onReadyRead(const std::shared_ptr<Client>& client);
+    void submit(const std::shared_ptr<Client>& client, const QByteArray& frame);
+    /// списание транзакции с квоты клиента и общей квоты его линии
+    bool takeToken(Client& client);
+
+    Scheduler* scheduler_;
+    Quota quota_;
+    Lane lane_ = Lane::Background;
+    std::map<QLocalServer*, Device*> servers_;
+    std::map<Device*, Bucket> lines_;
+    /// шлюз удалён: ещё не начатые задачи шлюза в планировщике ничего не выполняют
+    std::shared_ptr<std::atomic<bool>> closed_ { std::make_shared<std::atomic<bool>>() };
+    std::map<QLocalSocket*, std::shared_ptr<Client>> clients_;
+};
+
+} // namespace Elemer
@@ -0,0 +1,17 @@
+QT += core network serialport
+QT -= gui
+
+CONFIG += c++2a console
+CONFIG -= app_bundle
+
+TARGET = elemer-gateway
+TEMPLATE = app
+
+include(../ElemerDevice.pri)
+
+HEADERS += \
+    $$PWD/ed_gateway.h
+
+SOURCES += \
+    $$PWD/ed_gateway.cpp \
+    $$PWD/main.cpp
@@ -0,0 +1,117 @@
+#include "ed_device.h"
+#include "ed_gateway.h"
+#include "ed_scheduler.h"
+#include "ed_shm.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QTimer>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+using namespace Elemer;
+
+// elemer-gateway --line /dev/ttyUSB0,9600,75,1,elemer-ttyUSB0,1000 [--shm /elemer] [--reconnect 5]
+// line: порт, скорость, тип прибора, адрес, имя сокета[, период опроса ReadData, мс]
+
+namespace {
+
+/// параметры подключения прибора линии для повторного поиска
+struct Link {
+    Device* device;
+    QString port;
+    int baud;
+    int address;
+    std::atomic<bool> reconnecting {};
+    std::atomic<bool> reported {}; ///< сообщение "не отвечает" выведено, до восстановления связи не повторяется
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("elemer-gateway");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Шлюз локальных клиентов к линиям приборов ЭЛЕМЕР");
+    parser.addHelpOption();
+    QCommandLineOption lineOption("line", "порт,скорость,тип,адрес,сокет[,период мс]", "line");
+    QCommandLineOption shmOption("shm", "имя сегмента разделяемой памяти для результатов опроса", "name");
+    QCommandLineOption reconnectOption("reconnect", "период повторного поиска отключённых приборов, с", "s", "5");
+    parser.addOptions({ lineOption, shmOption, reconnectOption });
+    parser.process(app);
+
+    const QStringList lines = parser.values(lineOption);
+    if (lines.isEmpty())
+        parser.showHelp(1);
+
+    Scheduler scheduler;
+    Gateway gateway(&scheduler);
+    QObject::connect(&gateway, &Gateway::message, [](const QString& msg) { qWarning() << msg; });
+
+    std::unique_ptr<ShmPublisher> publisher;
+    if (parser.isSet(shmOption))
+        publisher = std::make_unique<ShmPublisher>(parser.value(shmOption).toStdString(), lines.size());
+
+    std::vector<std::unique_ptr<DynamicDevice>> devices;
+    std::vector<std::unique_ptr<Samples>> samples;
+    std::vector<std::unique_ptr<Link>> links;
+    for (const QString& line : lines) {
+        const QStringList f = line.split(',');
+        if (f.size() < 5) {
+            qCritical() << "bad --line" << line;
+            return 1;
+        }
+        auto device = std::make_unique<DynamicDevice>(static_cast<DeviceType>(f[2].toInt()));
+        QObject::connect(device.get(), &Device::message, [port = f[0]](const QString& msg) { qWarning() << port << msg; });
+        // первый ping - в reconnect() после запуска планировщика, в потоке порта
+        links.emplace_back(std::make_unique<Link>(device.get(), f[0], f[1].toInt(), f[3].toInt()));
+        if (!gateway.listen(device.get(), f[4]))
+            return 1;
+        if (f.size() > 5 && f[5].toInt() > 0) {
+            auto& buffer = samples.emplace_back(std::make_unique<Samples>(device->makeSamples()));
+            if (publisher && publisher->isValid())
+                device->setPublisher(publisher.get(), static_cast<uint32_t>(devices.size()));
+            scheduler.addPeriodic(device.get(), std::chrono::milliseconds(f[5].toInt()),
+                [dev = device.get(), buf = buffer.get()] { return dev->readData(*buf); });
+        }
+        devices.emplace_back(std::move(device));
+    }
+
+    // приборы, ещё не найденные или потерявшие связь, ищутся заново в потоке их порта
+    const auto reconnect = [&scheduler, &links] {
+        for (const auto& link : links) {
+            if (link->device->isConnected() || link->reconnecting.exchange(true))
+                continue;
+            scheduler.post(
+                link->device, [l = link.get()] {
+                    const bool ok = l->device->ping(l->port, l->baud, l->address);
+                    if (ok)
+                        l->reported = false;
+                    else if (!l->reported.exchange(true))
+                        qWarning() << l->port << "прибор не отвечает";
+                    l->reconnecting = false;
+                    return ok;
+                },
+                Lane::Background);
+        }
+    };
+    QTimer reconnectTimer;
+    QObject::connect(&reconnectTimer, &QTimer::timeout, reconnect);
+
+    scheduler.start();
+    reconnect();
+    if (const int period = parser.value(reconnectOption).toInt(); period > 0)
+        reconnectTimer.start(period * 1000);
+    const int ret = app.exec();
+    reconnectTimer.stop();
+    std::vector<Device*> all;
+    for (const auto& device : devices)
+        all.push_back(device.get());
+    // задачи планировщика обращаются к портам - порты останавливаются последними
+    Device::abortAll(all);
+    scheduler.stop();
+    Device::shutdownAll(all);
+    return ret;
+}